@@ -1,56 +1,234 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
 #include <thread>
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
 using namespace std;
 
 #include "src/bitmap.h"
+#include "src/bvh.h"
 #include "src/camera.h"
+#include "src/checkpoint.h"
+#include "src/denoiser.h"
 #include "src/hittable_list.h"
 #include "src/hittable.h"
+#include "src/instance.h"
+#include "src/light_list.h"
 #include "src/material.h"
 #include "src/moving_sphere.h"
+#include "src/numa.h"
+#include "src/obj_loader.h"
+#include "src/preview_server.h"
 #include "src/ray.h"
+#include "src/render_job.h"
 #include "src/rtweekend.h"
+#include "src/sampler.h"
+#include "src/scene_watch.h"
 #include "src/sphere.h"
+#include "src/triangle_mesh.h"
 #include "src/vec3.h"
 
-color ray_color(const ray &r, const hittable &world, int depth)
+/// light arriving at rec.p straight from one sampled light, weighted against finding it by scattering
+color sample_light(const ray &r, const hit_record &rec, const hittable &world, const light_list &lights)
 {
-    hit_record rec;
+    vec3 direction;
+    int index;
+    if (!lights.sample(rec.p, direction, index))
+        return color(0, 0, 0);
 
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-    {
+    ray shadow(rec.p, direction, r.time());
+    double scatter_pdf = rec.mat_ptr->scattering_pdf(r, rec, shadow);
+    hit_record light_rec;
+
+    if (scatter_pdf <= 0 || !lights.lights[index]->hit(shadow, 0.001, infinity, light_rec))
         return color(0, 0, 0);
+    if (world.occluded(shadow, 0.001, light_rec.t * (1 - 1e-6)))
+        return color(0, 0, 0);
+
+    double light_pdf = lights.pdf(index, rec.p);
+    return scatter_pdf * light_rec.mat_ptr->emitted(light_rec) * power_heuristic(light_pdf, scatter_pdf) / light_pdf;
+}
+
+/// what a render kernel is specialized for; a kernel without a feature drops its branches entirely.
+/// Only per-bounce work is worth a specialization: the camera's lens and shutter branches run once per
+/// sample and unrolling the bounces made no measurable difference
+enum render_feature
+{
+    feature_emission = 1,        // something may emit, so gather emission and sample lights
+    feature_lambertian_only = 2, // every surface is lambertian, so scatter without virtual calls
+    feature_count = 4
+};
+
+/// the material of a scene object with a single one, nullptr for anything else
+shared_ptr<material> material_of(const shared_ptr<hittable> &object)
+{
+    if (auto s = std::dynamic_pointer_cast<sphere>(object))
+    {
+        return s->mat_ptr;
+    }
+    if (auto s = std::dynamic_pointer_cast<moving_sphere>(object))
+    {
+        return s->mat_ptr;
+    }
+    if (auto m = std::dynamic_pointer_cast<triangle_mesh>(object))
+    {
+        return m->mat_ptr;
+    }
+    return nullptr;
+}
+
+/// add every material under object to materials, looking through instances and bvhs; a prototype placed
+/// many times is walked once. False when some object's material cannot be known
+bool collectMaterials(const shared_ptr<hittable> &object, set<const hittable *> &visited, vector<shared_ptr<material>> &materials)
+{
+    if (!visited.insert(object.get()).second)
+    {
+        return true;
+    }
+
+    if (auto mat = material_of(object))
+    {
+        materials.push_back(mat);
+        return true;
+    }
+    if (auto t = std::dynamic_pointer_cast<translate>(object))
+    {
+        return collectMaterials(t->ptr, visited, materials);
+    }
+    if (auto r = std::dynamic_pointer_cast<rotate_y>(object))
+    {
+        return collectMaterials(r->ptr, visited, materials);
+    }
+    if (auto b = std::dynamic_pointer_cast<bvh_node>(object))
+    {
+        return collectMaterials(b->left, visited, materials) && collectMaterials(b->right, visited, materials);
+    }
+    return false;
+}
+
+/// what the scene of a job needs; unknown objects are assumed to need everything
+int sceneFeatures(const hittable_list &world)
+{
+    set<const hittable *> visited;
+    vector<shared_ptr<material>> materials;
+    bool known = true;
+
+    for (const auto &object : world.objects)
+    {
+        known = collectMaterials(object, visited, materials) && known;
     }
 
-    if (world.hit(r, 0.001, infinity, rec))
+    bool emission = !known;
+    bool lambertianOnly = known;
+    for (const auto &mat : materials)
+    {
+        emission = emission || std::dynamic_pointer_cast<diffuse_light>(mat);
+        lambertianOnly = lambertianOnly && std::dynamic_pointer_cast<lambertian>(mat);
+    }
+
+    int features = 0;
+    if (emission)
+        features |= feature_emission;
+    if (lambertianOnly && !emission)
+        features |= feature_lambertian_only;
+    return features;
+}
+
+/// the path tracer, specialized on a feature mask
+template <int Features>
+struct path_kernel
+{
+    static color trace(const ray &r, const hittable &world, const light_list &lights, int depth, double scatter_pdf)
     {
+        hit_record rec;
+
+        // If we've exceeded the ray bounce limit, no more light is gathered.
+        if (depth <= 0)
+        {
+            return color(0, 0, 0);
+        }
+
+        if (!world.intersect(r, 0.001, infinity, rec))
+        {
+            vec3 unit_direction = unit_vector(r.direction());
+            auto t = 0.5 * (unit_direction.y() + 1.0);
+            return (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+        }
+
+        /// hit() without forgetting the object, an emitter's weight depends on which light it is
+        const hittable *object = rec.object;
+        if (object)
+        {
+            object->shade(r, rec);
+        }
+
         ray scattered;
         color attenuation;
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-            return attenuation * ray_color(scattered, world, depth - 1);
-        return color(0, 0, 0);
+
+        if (Features & feature_lambertian_only)
+        {
+            /// a qualified call is not virtual, so it inlines
+            static_cast<const lambertian *>(rec.mat_ptr)->lambertian::scatter(r, rec, attenuation, scattered);
+            return attenuation * trace(scattered, world, lights, depth - 1, -1);
+        }
+
+        color result(0, 0, 0);
+        if (Features & feature_emission)
+        {
+            result = rec.mat_ptr->emitted(rec);
+            if (scatter_pdf > 0 && !result.near_zero())
+            {
+                result *= power_heuristic(scatter_pdf, lights.pdf(lights.index_of(object), r.origin()));
+            }
+        }
+
+        if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
+            return result;
+
+        double next_pdf = -1;
+        if (Features & feature_emission)
+        {
+            next_pdf = rec.mat_ptr->scattering_pdf(r, rec, scattered);
+            if (next_pdf > 0 && !lights.empty())
+            {
+                result += attenuation * sample_light(r, rec, world, lights);
+            }
+        }
+
+        return result + attenuation * trace(scattered, world, lights, depth - 1, next_pdf > 0 ? next_pdf : -1);
     }
+};
 
-    vec3 unit_direction = unit_vector(r.direction());
-    auto t = 0.5 * (unit_direction.y() + 1.0);
-    return (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+/// scatter_pdf is the density of the bounce that produced r, or -1 for camera rays and
+/// mirror-like bounces, whose emission light sampling could not have found
+color ray_color(const ray &r, const hittable &world, const light_list &lights, int depth, double scatter_pdf = -1)
+{
+    return path_kernel<feature_emission>::trace(r, world, lights, depth, scatter_pdf);
 }
 
-hittable_list readWorld(string fileName)
+/// camera ray and path for one sample with the kernel's features
+template <int Features>
+inline color trace_sample(const camera &cam, const camera_sample &cs, double u, double v, const hittable &world, const light_list &lights, int max_depth)
+{
+    ray r = cam.get_ray(u, v, cs.lens_s, cs.lens_t, cs.time);
+    return path_kernel<Features>::trace(r, world, lights, max_depth, -1);
+}
+
+/// the materials a scene file can name
+map<string, shared_ptr<material>> sceneMaterials()
 {
-    ifstream infile(fileName);
-    hittable_list world;
-    string myText;
     map<string, shared_ptr<material>> materialTypes;
 
     // diffuse
@@ -68,61 +246,128 @@ hittable_list readWorld(string fileName)
     materialTypes.insert(pair<string, shared_ptr<material>>("material_diffuse", material_diffuse));
     materialTypes.insert(pair<string, shared_ptr<material>>("material_metal", material_metal));
     materialTypes.insert(pair<string, shared_ptr<material>>("material_glass", material_glass));
+    materialTypes.insert(pair<string, shared_ptr<material>>("material_light", make_shared<diffuse_light>(color(4, 4, 4))));
 
-    std::cout << "Reading scene file\n";
+    return materialTypes;
+}
 
-    /// for each line of file
-    while (getline(infile, myText))
+/// the object one line of a scene file describes, or nullptr for comments and unknown lines
+shared_ptr<hittable> readSceneLine(const string &myText, map<string, shared_ptr<material>> &materialTypes)
+{
+    string text;
+    string geometry;
+    string meshFile;
+    double arr[4];
+    string materialType;
+    int i = 0;
+    stringstream ss(myText);
+
+    /// for each word of line
+    while (ss.good() && i < 6)
     {
-        string text;
-        string geometry;
-        double arr[4];
-        string materialType;
-        int i = 0;
-        stringstream ss(myText);
 
-        /// for each word of line
-        while (ss.good() && i < 6)
+        /// define geometry type
+        if (i == 0)
         {
+            ss >> text;
 
-            /// define geometry type
-            if (i == 0)
+            /// skip comments
+            if (text == "#")
             {
-                ss >> text;
-
-                /// skip comments
-                if (text == "#")
-                {
-                    break;
-                }
-                else
-                {
-                    geometry = text;
-                }
+                break;
             }
-
-            /// define geometry size and position
-            else if (i > 0 && i < 5)
+            else
             {
-                ss >> arr[i - 1];
+                geometry = text;
             }
 
-            /// define geometry material
-            else
+            /// meshes name their OBJ file before the numbers
+            if (geometry == "mesh")
             {
-                ss >> materialType;
+                ss >> meshFile;
             }
+        }
+
+        /// define geometry size and position
+        else if (i > 0 && i < 5)
+        {
+            ss >> arr[i - 1];
+        }
 
-            ++i;
+        /// define geometry material
+        else
+        {
+            ss >> materialType;
         }
 
+        ++i;
+    }
+
+    /// unknown material names are skipped rather than dereferenced
+    auto mat = materialTypes.find(materialType);
+    if ((geometry != "sphere" && geometry != "mesh") || mat == materialTypes.end())
+    {
+        return nullptr;
+    }
+
+    if (geometry == "sphere")
+    {
+        return make_shared<sphere>(point3(-arr[0], arr[1], arr[2]), arr[3], mat->second);
+    }
+
+    /// position and scale the mesh the same way as a sphere's center and radius
+    vector<point3> vertices;
+    vector<int> indices;
+
+    if (!load_obj(meshFile, vertices, indices))
+    {
+        std::cout << "Could not read mesh " << meshFile << "\n";
+        return nullptr;
+    }
+
+    for (auto &v : vertices)
+    {
+        v = point3(-arr[0], arr[1], arr[2]) + arr[3] * v;
+    }
+
+    auto mesh = make_shared<triangle_mesh>(std::move(vertices), std::move(indices), mat->second);
+    std::cout << "Loaded " << meshFile << " (" << mesh->triangle_count() << " triangles)\n";
+    return mesh;
+}
+
+/// read the scene file; with a watch, also remember which object every line produced
+hittable_list readWorld(string fileName, scene_watch *watch = nullptr)
+{
+    ifstream infile(fileName);
+    hittable_list world;
+    string myText;
+    map<string, shared_ptr<material>> materialTypes = sceneMaterials();
+
+    std::cout << "Reading scene file\n";
+
+    /// for each line of file
+    while (getline(infile, myText))
+    {
+        auto object = readSceneLine(myText, materialTypes);
+
         /// add geometry to list
-        if (geometry == "sphere")
+        if (object)
+        {
+            world.add(object);
+        }
+
+        if (watch)
         {
-            world.add(make_shared<sphere>(point3(-arr[0], arr[1], arr[2]), arr[3], materialTypes.find(materialType)->second));
+            watch->lines.push_back(myText);
+            watch->objects.push_back(object);
         }
     }
 
+    if (watch)
+    {
+        watch->materials = materialTypes;
+    }
+
     return world;
 }
 
@@ -183,9 +428,66 @@ hittable_list random_scene()
     return world;
 }
 
-void render(int image_height, int image_width, int samples_per_pixel, int max_depth, camera cam, hittable_list world, int startColumn, int endColumn)
+hittable_list instanced_scene()
+{
+    hittable_list world;
+
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+    /// build one cluster of small spheres, with its own bvh, around the origin
+    hittable_list cluster;
+    for (int k = 0; k < 64; k++)
+    {
+        auto choose_mat = random_double();
+        point3 center(random_double(-0.5, 0.5), random_double(0.05, 0.6), random_double(-0.5, 0.5));
+        shared_ptr<material> sphere_material;
+
+        if (choose_mat < 0.8)
+            sphere_material = make_shared<lambertian>(color::random() * color::random());
+        else if (choose_mat < 0.95)
+            sphere_material = make_shared<metal>(color::random(0.5, 1), random_double(0, 0.5));
+        else
+            sphere_material = make_shared<dielectric>(1.5);
+
+        cluster.add(make_shared<sphere>(center, 0.05, sphere_material));
+    }
+    auto cluster_bvh = make_shared<bvh_node>(cluster, 0.0, 1.0);
+
+    /// place the shared cluster on a grid, each copy turned a different way
+    for (int a = -16; a < 16; a++)
+    {
+        for (int b = -16; b < 16; b++)
+        {
+            world.add(make_instance(cluster_bvh, vec3(a * 1.2, 0, b * 1.2), random_double(0, 360)));
+        }
+    }
+
+    return world;
+}
+
+void writePixel(unsigned char *pos, color pixel_color, int samples_per_pixel)
+{
+    auto r = pixel_color.x();
+    auto g = pixel_color.y();
+    auto b = pixel_color.z();
+
+    // Divide the color by the number of samples and gamma-correct for gamma=2.0.
+    auto scale = 1.0 / samples_per_pixel;
+    r = sqrt(scale * r);
+    g = sqrt(scale * g);
+    b = sqrt(scale * b);
+
+    pos[0] = (unsigned char)(256 * clamp(r, 0.0, 0.999));
+    pos[1] = (unsigned char)(256 * clamp(g, 0.0, 0.999));
+    pos[2] = (unsigned char)(256 * clamp(b, 0.0, 0.999));
+}
+
+template <int Features>
+void render(int image_height, int image_width, int samples_per_pixel, int max_depth, camera cam, hittable_list world, const light_list &lights, int startColumn, int endColumn, unsigned char *buffer, int frame)
 {
-    int aniCount = 0;
+    /// give every frame and column band its own random stream
+    seed_random((uint64_t)frame * image_width + startColumn);
 
     // Render
     for (int j = image_height - 1; j >= 0; --j)
@@ -194,127 +496,1511 @@ void render(int image_height, int image_width, int samples_per_pixel, int max_de
         {
             color pixel_color(0, 0, 0);
 
+            pixel_sampler sampler(((uint64_t)frame * image_height + j) * image_width + i);
+
             for (int s = 0; s < samples_per_pixel; ++s)
             {
-                auto u = (i + random_double()) / (image_width - 1);
-                auto v = (j + random_double()) / (image_height - 1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
+                camera_sample cs = sampler.get(s);
+                auto u = (i + cs.px) / (image_width - 1);
+                auto v = (j + cs.py) / (image_height - 1);
+                pixel_color += trace_sample<Features>(cam, cs, u, v, world, lights, max_depth);
             }
 
-            auto r = pixel_color.x();
-            auto g = pixel_color.y();
-            auto b = pixel_color.z();
+            writePixel(&buffer[j * line_size + i * cel_size], pixel_color, samples_per_pixel);
+        }
+    }
+}
+
+/// add samples firstSample.. to a column band of the float accumulation buffer, continuing the band's random stream
+template <int Features>
+void renderPass(int image_height, int image_width, int samples, int max_depth, camera cam, const hittable_list &world, const light_list &lights, int startColumn, int endColumn, float *accum, uint64_t *rngState, int frame, int firstSample)
+{
+    random_state() = *rngState;
+
+    for (int j = image_height - 1; j >= 0; --j)
+    {
+        for (int i = startColumn; i < endColumn; ++i)
+        {
+            color pixel_color(0, 0, 0);
 
-            // Divide the color by the number of samples and gamma-correct for gamma=2.0.
-            auto scale = 1.0 / samples_per_pixel;
-            r = sqrt(scale * r);
-            g = sqrt(scale * g);
-            b = sqrt(scale * b);
+            pixel_sampler sampler(((uint64_t)frame * image_height + j) * image_width + i);
 
-            unsigned char *pos = &img[j * line_size + i * cel_size];
+            for (int s = 0; s < samples; ++s)
+            {
+                camera_sample cs = sampler.get(firstSample + s);
+                auto u = (i + cs.px) / (image_width - 1);
+                auto v = (j + cs.py) / (image_height - 1);
+                pixel_color += trace_sample<Features>(cam, cs, u, v, world, lights, max_depth);
+            }
 
-            pos[0] = (unsigned char)(256 * clamp(r, 0.0, 0.999));
-            pos[1] = (unsigned char)(256 * clamp(g, 0.0, 0.999));
-            pos[2] = (unsigned char)(256 * clamp(b, 0.0, 0.999));
-            Sleep(5);
+            float *pos = &accum[(j * image_width + i) * 3];
+            pos[0] += (float)pixel_color.x();
+            pos[1] += (float)pixel_color.y();
+            pos[2] += (float)pixel_color.z();
         }
     }
+
+    *rngState = random_state();
 }
 
-int main()
+/// render one tile into rows, a buffer whose first row is the tile's startRow
+template <int Features>
+void renderTile(int image_height, int image_width, int samples_per_pixel, int max_depth, camera cam, const hittable_list &world, const light_list &lights, int startColumn, int endColumn, int startRow, int endRow, unsigned char *rows, int frame)
 {
+    /// give every tile its own random stream
+    seed_random(((uint64_t)frame * image_height + startRow) * image_width + startColumn);
 
-    // Image
-    const auto aspect_ratio = 16.0 / 9.0;
-    const int image_width = 720;
-    const int image_height = static_cast<int>(image_width / aspect_ratio);
-    const int samples_per_pixel = 100;
-    const int max_depth = 5;
+    for (int j = startRow; j < endRow; ++j)
+    {
+        for (int i = startColumn; i < endColumn; ++i)
+        {
+            color pixel_color(0, 0, 0);
 
-    img = new unsigned char[image_width * image_height * 3 * sizeof(int)];
-    cel_size = sizeof(unsigned char) * 3;
-    line_size = cel_size * image_width;
+            pixel_sampler sampler(((uint64_t)frame * image_height + j) * image_width + i);
 
-    // Read world from file
-    hittable_list world;
-    string readWorldFromFile;
-    std::cout << "Read input file? [Y] / [N]: ";
-    std::cin >> readWorldFromFile;
+            for (int s = 0; s < samples_per_pixel; ++s)
+            {
+                camera_sample cs = sampler.get(s);
+                auto u = (i + cs.px) / (image_width - 1);
+                auto v = (j + cs.py) / (image_height - 1);
+                pixel_color += trace_sample<Features>(cam, cs, u, v, world, lights, max_depth);
+            }
 
-    if (readWorldFromFile == "Y" || readWorldFromFile == "y")
-    {
-        world = readWorld("input.txt");
-    }
-    else if (readWorldFromFile == "N" || readWorldFromFile == "n")
-    {
-        world = random_scene();
+            writePixel(&rows[(j - startRow) * line_size + i * cel_size], pixel_color, samples_per_pixel);
+        }
     }
+}
 
-    // Camera
-    point3 lookfrom(13, 2, 3);
-    point3 lookat(0, 0, 0);
-    vec3 vup(0, 1, 0);
-    auto dist_to_focus = 10.0;
-    auto aperture = 0.1;
+/// render rows startRow..endRow tile by tile into a buffer that holds only those rows
+template <int Features>
+void renderBand(int image_height, int image_width, int samples_per_pixel, int max_depth, camera cam, const hittable_list &world, const light_list &lights, int startRow, int endRow, unsigned char *band, atomic<int> &nextTile, int frame)
+{
+    const int tile_width = 64;
+    int tiles = (image_width + tile_width - 1) / tile_width;
 
-    camera cam(lookfrom, lookat, vup, 20, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
+    for (int t = nextTile++; t < tiles; t = nextTile++)
+    {
+        int startColumn = t * tile_width;
+        int endColumn = std::min(startColumn + tile_width, image_width);
+        renderTile<Features>(image_height, image_width, samples_per_pixel, max_depth, cam, world, lights, startColumn, endColumn, startRow, endRow, band, frame);
+    }
+}
 
-    // Output image
-    string imgPreffix = "images/image";
-    string imgSuffix = ".bmp";
+/// the render entry points of one kernel specialization
+struct render_kernels
+{
+    void (*render)(int, int, int, int, camera, hittable_list, const light_list &, int, int, unsigned char *, int);
+    void (*renderPass)(int, int, int, int, camera, const hittable_list &, const light_list &, int, int, float *, uint64_t *, int, int);
+    void (*renderBand)(int, int, int, int, camera, const hittable_list &, const light_list &, int, int, unsigned char *, atomic<int> &, int);
+    void (*renderTile)(int, int, int, int, camera, const hittable_list &, const light_list &, int, int, int, int, unsigned char *, int);
+};
 
-    // Render
-    std::thread *threadList;
-    int threads;
+template <int Features>
+void fillKernels(render_kernels *table)
+{
+    table[Features].render = render<Features>;
+    table[Features].renderPass = renderPass<Features>;
+    table[Features].renderBand = renderBand<Features>;
+    table[Features].renderTile = renderTile<Features>;
+    fillKernels<Features - 1>(table);
+}
 
-    std::cout << "Threads to use: ";
-    std::cin >> threads;
+template <>
+void fillKernels<-1>(render_kernels *table)
+{
+}
 
-    threadList = new std::thread[threads];
-    int pixel_per_thread = (image_width / threads);
+/// every specialization, indexed by feature mask
+struct kernel_table
+{
+    render_kernels kernels[feature_count];
 
-    double x = 5;
-    double y = 1;
-    double z = 2;
+    kernel_table() { fillKernels<feature_count - 1>(kernels); }
+};
 
-    double images;
-    std::cout << "Images to render: ";
-    std::cin >> images;
-    double moveSize = (x * 2) / images;
+/// the kernels for a feature mask, picked once per job
+render_kernels selectKernels(int features)
+{
+    static const kernel_table table;
+    return table.kernels[features];
+}
 
-    /// get time before start rendering
-    using std::chrono::duration_cast;
-    using std::chrono::high_resolution_clock;
-    using std::chrono::seconds;
-    auto t0 = high_resolution_clock::now();
-    auto t1 = t0;
-    auto sumRenderTime = duration_cast<seconds>(t1 - t0);
+/// albedo, normal and depth of the first diffuse hit for a column band, from a fixed 4x4 grid of rays per pixel
+void renderAov(int image_height, int image_width, camera cam, const hittable_list &world, int startColumn, int endColumn, aov_buffers *aov)
+{
+    /// lens samples come from the band's own random stream
+    seed_random(startColumn);
 
-    std::cout << "Rendering " << images << " images with " << threads << " threads\n";
-\
-    for (int c = 0; c < images; c++)
+    for (int j = image_height - 1; j >= 0; --j)
     {
-        camera cam(vec3(x, y, z), lookat, vup, 90, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
-
-        for (int i = 0; i < threads; i++)
+        for (int i = startColumn; i < endColumn; ++i)
         {
-            if (i == threads - 1)
+            color albedo(0, 0, 0);
+            vec3 normal(0, 0, 0);
+            double depth = 0;
+
+            for (int s = 0; s < 16; ++s)
             {
-                threadList[i] = std::thread(render, image_height, image_width, samples_per_pixel, max_depth, cam, world, pixel_per_thread * i, image_width);
+                auto u = (i + 0.125 + 0.25 * (s % 4)) / (image_width - 1);
+                auto v = (j + 0.125 + 0.25 * (s / 4)) / (image_height - 1);
+                ray r = cam.get_ray(u, v);
+                color throughput(1, 1, 1);
+                double distance = 0;
+
+                /// look through mirrors and glass, so the guide shows what they reflect or refract
+                for (int bounce = 0; bounce < 4; ++bounce)
+                {
+                    hit_record rec;
+                    if (!world.hit(r, 0.001, infinity, rec))
+                    {
+                        albedo += throughput;
+                        break;
+                    }
+                    distance += rec.t * r.direction().length();
+
+                    ray scattered;
+                    color attenuation;
+                    bool specular = rec.mat_ptr->scatter(r, rec, attenuation, scattered) && rec.mat_ptr->scattering_pdf(r, rec, scattered) <= 0;
+
+                    if (!specular || bounce == 3)
+                    {
+                        albedo += throughput * rec.mat_ptr->aov_albedo();
+                        normal += rec.normal;
+                        depth += distance;
+                        break;
+                    }
+
+                    throughput = throughput * attenuation;
+                    r = scattered;
+                }
             }
-            else
+
+            int p = j * image_width + i;
+            for (int c = 0; c < 3; c++)
             {
-                threadList[i] = std::thread(render, image_height, image_width, samples_per_pixel, max_depth, cam, world, pixel_per_thread * i, (pixel_per_thread * i) + pixel_per_thread);
+                aov->albedo[p * 3 + c] = (float)(albedo[c] / 16);
+                aov->normal[p * 3 + c] = normal.near_zero() ? 0.0f : (float)unit_vector(normal)[c];
             }
+            aov->depth[p] = (float)(depth / 16);
         }
+    }
+}
+
+/// denoise a finished float frame when asked to, then quantize it into an 8-bit buffer
+void resolveImage(const float *accum, int samples_per_pixel, int image_height, int image_width, camera cam, const hittable_list &world, bool denoiseImage, int threads, unsigned char *buffer)
+{
+    std::vector<float> filtered;
+
+    if (denoiseImage)
+    {
+        aov_buffers aov;
+        aov.resize(image_width, image_height);
 
+        /// the guide takes the same column bands as the render
+        std::thread *threadList = new std::thread[threads];
+        int pixel_per_thread = (image_width / threads);
         for (int i = 0; i < threads; i++)
         {
-            threadList[i].join();
+            int endColumn = (i == threads - 1) ? image_width : (pixel_per_thread * i) + pixel_per_thread;
+            threadList[i] = std::thread(renderAov, image_height, image_width, cam, std::cref(world), pixel_per_thread * i, endColumn, &aov);
         }
 
-        x -= moveSize;
+        for (int i = 0; i < threads; i++)
+        {
+            threadList[i].join();
+        }
+        delete[] threadList;
+
+        denoise(accum, samples_per_pixel, aov, image_width, image_height, threads, filtered);
+        accum = filtered.data();
+        samples_per_pixel = 1;
+    }
+
+    for (int j = 0; j < image_height; j++)
+    {
+        for (int i = 0; i < image_width; i++)
+        {
+            const float *sum = &accum[(j * image_width + i) * 3];
+            writePixel(&buffer[j * line_size + i * cel_size], color(sum[0], sum[1], sum[2]), samples_per_pixel);
+        }
+    }
+}
+
+/// render whole frames of the camera sweep, one frame per job
+void renderFrames(const render_job &job, const hittable_list &world, const light_list &lights, render_kernels kernels, atomic<int> &nextFrame, mutex &outputMutex)
+{
+    const int image_height = job.image_height;
+    const int image_width = job.image_width;
+    const int samples_per_pixel = job.samples_per_pixel;
+    const int max_depth = job.max_depth;
+    unsigned char *buffer = new unsigned char[image_width * image_height * 3];
+
+    for (int c = nextFrame++; c < job.images; c = nextFrame++)
+    {
+        camera cam = job.sweepCamera(c);
+
+        if (job.denoiseImage)
+        {
+            /// the denoiser needs the float frame, so accumulate before quantizing
+            vector<float> accum((size_t)image_width * image_height * 3, 0.0f);
+            uint64_t rngState = seeded_state((uint64_t)c * image_width);
+            kernels.renderPass(image_height, image_width, samples_per_pixel, max_depth, cam, world, lights, 0, image_width, accum.data(), &rngState, c, 0);
+            resolveImage(accum.data(), samples_per_pixel, image_height, image_width, cam, world, true, 1, buffer);
+        }
+        else
+        {
+            kernels.render(image_height, image_width, samples_per_pixel, max_depth, cam, world, lights, 0, image_width, buffer, c);
+        }
+
+        ofstream outfile;
+        outfile.open(job.fileName(c), ios::binary | ios::out);
+        writeBitmapFile(outfile, buffer, image_width, image_height);
+        outfile.close();
+
+        lock_guard<mutex> lock(outputMutex);
+        std::cout << "image " << c << " done\n";
+    }
+
+    delete[] buffer;
+}
+
+/// column-mode render that saves its progress after every pass of samples
+void renderWithCheckpoints(const render_job &job, const hittable_list &world, const light_list &lights, render_kernels kernels, bool resume, uint64_t sceneHash, string checkpointFile)
+{
+    const int checkpoint_samples = 10;
+    const int image_height = job.image_height;
+    const int image_width = job.image_width;
+    const int samples_per_pixel = job.samples_per_pixel;
+    const int images = job.images;
+    const int threads = job.threads;
+    std::thread *threadList = new std::thread[threads];
+    int pixel_per_thread = (image_width / threads);
+
+    checkpoint cp;
+    if (resume && loadCheckpoint(checkpointFile, cp) && cp.matches(image_width, image_height, samples_per_pixel, images, threads, sceneHash))
+    {
+        std::cout << "Resuming image " << cp.frame << " at " << cp.samples << "/" << samples_per_pixel << " samples\n";
+    }
+    else
+    {
+        if (resume)
+        {
+            std::cout << "No matching checkpoint, starting from the first image\n";
+        }
+
+        cp = checkpoint();
+        cp.image_width = image_width;
+        cp.image_height = image_height;
+        cp.samples_per_pixel = samples_per_pixel;
+        cp.images = images;
+        cp.threads = threads;
+        cp.scene_hash = sceneHash;
+        cp.x = job.x;
+        cp.accum.assign((size_t)image_width * image_height * 3, 0.0f);
+        cp.rng_states.resize(threads);
+
+        for (int i = 0; i < threads; i++)
+        {
+            cp.rng_states[i] = seeded_state((uint64_t)pixel_per_thread * i);
+        }
+    }
+
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::seconds;
+    auto t0 = high_resolution_clock::now();
+
+    for (int c = cp.frame; c < images; c++)
+    {
+        camera cam = job.cameraAt(point3(cp.x, job.y, job.z));
+
+        while (cp.samples < samples_per_pixel)
+        {
+            int samples = min(checkpoint_samples, samples_per_pixel - cp.samples);
+
+            for (int i = 0; i < threads; i++)
+            {
+                int endColumn = (i == threads - 1) ? image_width : (pixel_per_thread * i) + pixel_per_thread;
+                threadList[i] = std::thread(kernels.renderPass, image_height, image_width, samples, job.max_depth, cam, std::cref(world), std::cref(lights), pixel_per_thread * i, endColumn, cp.accum.data(), &cp.rng_states[i], c, cp.samples);
+            }
+
+            for (int i = 0; i < threads; i++)
+            {
+                threadList[i].join();
+            }
+
+            cp.samples += samples;
+            if (!saveCheckpoint(checkpointFile, cp))
+            {
+                std::cout << "Could not write checkpoint " << checkpointFile << "\n";
+            }
+        }
+
+        resolveImage(cp.accum.data(), samples_per_pixel, image_height, image_width, cam, world, job.denoiseImage, threads, img);
+
+        ofstream outfile;
+        outfile.open(job.fileName(c), ios::binary | ios::out);
+        writeBitmapFile(outfile, image_width, image_height);
+        outfile.close();
+
+        /// move on to the next frame before checkpointing, so a resume never redoes a written image
+        cp.frame = c + 1;
+        cp.samples = 0;
+        cp.x -= job.moveSize;
+        std::fill(cp.accum.begin(), cp.accum.end(), 0.0f);
+        for (int i = 0; i < threads; i++)
+        {
+            cp.rng_states[i] = seeded_state((uint64_t)cp.frame * image_width + pixel_per_thread * i);
+        }
+        if (!saveCheckpoint(checkpointFile, cp))
+        {
+            std::cout << "Could not write checkpoint " << checkpointFile << "\n";
+        }
+
+        auto sumRenderTime = duration_cast<seconds>(high_resolution_clock::now() - t0);
+        std::cout << (c + 1) << "/" << images << " - render time: " << sumRenderTime.count() << "s\n";
+    }
+
+    std::remove(checkpointFile.c_str());
+    delete[] threadList;
+}
+
+/// one progressive preview pass over 32-pixel tiles: scale > 1 traces one ray per scale x scale block,
+/// scale 1 adds the next sample to every pixel still short of samples_per_pixel; stops as soon as the camera moves.
+/// Each scene edit gets its own sample sequence, so pixels topped up after an edit do not repeat old samples;
+/// a pixel shows its pre-edit history blended in until it has as many new samples as the history is worth
+void previewPass(int image_height, int image_width, int scale, int pass, int samples_per_pixel, int max_depth, camera cam, const hittable_list &world, const light_list &lights, float *accum, int *sampleCount, const float *history, int *historyWeight, unsigned char *buffer, atomic<int> &nextTile, const preview_server &server, int generation, int edits)
+{
+    const int tile_size = 32;
+    int tilesX = (image_width + tile_size - 1) / tile_size;
+    int tilesY = (image_height + tile_size - 1) / tile_size;
+
+    for (int t = nextTile++; t < tilesX * tilesY; t = nextTile++)
+    {
+        seed_random(((uint64_t)generation * 65536 + pass) * tilesX * tilesY + t);
+
+        int startColumn = (t % tilesX) * tile_size;
+        int startRow = (t / tilesX) * tile_size;
+        int endColumn = std::min(startColumn + tile_size, image_width);
+        int endRow = std::min(startRow + tile_size, image_height);
+
+        for (int j = startRow; j < endRow; j += scale)
+        {
+            if (server.generation != generation)
+            {
+                return;
+            }
+
+            for (int i = startColumn; i < endColumn; i += scale)
+            {
+                if (scale > 1)
+                {
+                    auto u = (i + 0.5 * scale) / (image_width - 1);
+                    auto v = (j + 0.5 * scale) / (image_height - 1);
+                    color pixel_color = ray_color(cam.get_ray(u, v), world, lights, max_depth);
+
+                    for (int bj = j; bj < std::min(j + scale, endRow); bj++)
+                    {
+                        for (int bi = i; bi < std::min(i + scale, endColumn); bi++)
+                        {
+                            writePixel(&buffer[bj * line_size + bi * cel_size], pixel_color, 1);
+                        }
+                    }
+                }
+                else
+                {
+                    int p = j * image_width + i;
+                    if (sampleCount[p] >= samples_per_pixel)
+                    {
+                        continue;
+                    }
+
+                    pixel_sampler sampler((((uint64_t)generation * 65536 + edits) * image_height + j) * image_width + i);
+                    camera_sample cs = sampler.get(sampleCount[p]++);
+                    auto u = (i + cs.px) / (image_width - 1);
+                    auto v = (j + cs.py) / (image_height - 1);
+                    color pixel_color = ray_color(cam.get_ray(u, v, cs.lens_s, cs.lens_t, cs.time), world, lights, max_depth);
+
+                    float *pos = &accum[p * 3];
+                    pos[0] += (float)pixel_color.x();
+                    pos[1] += (float)pixel_color.y();
+                    pos[2] += (float)pixel_color.z();
+
+                    if (sampleCount[p] >= historyWeight[p])
+                    {
+                        historyWeight[p] = 0;
+                        writePixel(&buffer[j * line_size + i * cel_size], color(pos[0], pos[1], pos[2]), sampleCount[p]);
+                    }
+                    else
+                    {
+                        const float *old = &history[p * 3];
+                        int weight = historyWeight[p];
+                        writePixel(&buffer[j * line_size + i * cel_size], color(pos[0] + old[0] * weight, pos[1] + old[1] * weight, pos[2] + old[2] * weight), sampleCount[p] + weight);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// true for objects that light the scene, whose edits change every pixel
+bool isEmissive(const shared_ptr<hittable> &object)
+{
+    return std::dynamic_pointer_cast<diffuse_light>(material_of(object)) != nullptr;
+}
+
+/// apply an edited scene file as a diff: unchanged lines keep their objects and only edited lines are parsed.
+/// When every edit turns a sphere into another sphere they are updated in place and the bvh is refit,
+/// otherwise the top level is rebuilt. changed gets the old and new bounds of every edit; returns true
+/// when a light was edited, so no pixel can keep its samples
+bool reloadWorld(scene_watch &watch, const vector<string> &lines, hittable_list &world, light_list &lights, vector<aabb> &changed)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    vector<shared_ptr<hittable>> objects(lines.size());
+    vector<bool> matched(lines.size(), false);
+    vector<bool> reused(watch.lines.size(), false);
+
+    /// unchanged in place first, then unchanged lines that moved
+    for (size_t k = 0; k < lines.size() && k < watch.lines.size(); k++)
+    {
+        if (lines[k] == watch.lines[k])
+        {
+            objects[k] = watch.objects[k];
+            matched[k] = reused[k] = true;
+        }
+    }
+
+    multimap<string, size_t> unused;
+    for (size_t k = 0; k < watch.lines.size(); k++)
+    {
+        if (!reused[k])
+        {
+            unused.insert(pair<string, size_t>(watch.lines[k], k));
+        }
+    }
+
+    bool inPlace = lines.size() == watch.lines.size() && watch.bvh;
+    int edits = 0;
+    for (size_t k = 0; k < lines.size(); k++)
+    {
+        if (matched[k])
+        {
+            continue;
+        }
+
+        auto moved = unused.find(lines[k]);
+        if (moved != unused.end())
+        {
+            objects[k] = watch.objects[moved->second];
+            reused[moved->second] = true;
+            unused.erase(moved);
+            inPlace = false;
+            continue;
+        }
+
+        objects[k] = readSceneLine(lines[k], watch.materials);
+        ++edits;
+
+        if (inPlace && (!std::dynamic_pointer_cast<sphere>(objects[k]) || !std::dynamic_pointer_cast<sphere>(watch.objects[k])))
+        {
+            inPlace = false;
+        }
+    }
+
+    bool everywhere = false;
+    aabb box;
+    for (size_t k = 0; k < watch.lines.size(); k++)
+    {
+        if (!reused[k] && watch.objects[k] && watch.objects[k]->bounding_box(0.0, 1.0, box))
+        {
+            changed.push_back(box);
+            everywhere = everywhere || isEmissive(watch.objects[k]);
+        }
+    }
+    for (size_t k = 0; k < lines.size(); k++)
+    {
+        if (!matched[k] && objects[k] && objects[k]->bounding_box(0.0, 1.0, box))
+        {
+            changed.push_back(box);
+            everywhere = everywhere || isEmissive(objects[k]);
+        }
+    }
+
+    hittable_list flat;
+    if (inPlace)
+    {
+        /// the bvh leaves point at the old spheres, so give them the new values
+        for (size_t k = 0; k < lines.size(); k++)
+        {
+            if (!matched[k])
+            {
+                auto target = std::dynamic_pointer_cast<sphere>(watch.objects[k]);
+                *target = *std::dynamic_pointer_cast<sphere>(objects[k]);
+                objects[k] = target;
+            }
+        }
+    }
+
+    for (const auto &object : objects)
+    {
+        if (object)
+        {
+            flat.add(object);
+        }
+    }
+
+    if (inPlace)
+    {
+        watch.bvh->refit(0.0, 1.0);
+    }
+    else
+    {
+        watch.bvh = flat.objects.empty() ? nullptr : make_shared<bvh_node>(flat, 0.0, 1.0);
+        world = watch.bvh ? hittable_list(watch.bvh) : hittable_list();
+    }
+    lights = light_list(flat);
+
+    watch.lines = lines;
+    watch.objects = objects;
+
+    auto updateTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start);
+    std::cout << "Scene update: " << edits << " edited lines, bvh " << (inPlace ? "refit" : "rebuild") << ", " << updateTime.count() << "ms\n";
+
+    return everywhere;
+}
+
+/// start every pixel over after an edit: an edit also shows up indirectly, in reflections, refractions and
+/// shadows cast from afar, so no converged pixel can be trusted. What the pixel showed is kept aside as
+/// history worth at most samples samples, and is dropped once the pixel has that many new ones
+void keepHistory(int pixels, int samples, float *accum, int *sampleCount, float *history, int *historyWeight)
+{
+    for (int p = 0; p < pixels; p++)
+    {
+        int weight = historyWeight[p];
+        int total = sampleCount[p] + weight;
+        if (total > 0)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                history[p * 3 + k] = (accum[p * 3 + k] + history[p * 3 + k] * weight) / total;
+            }
+        }
+
+        historyWeight[p] = std::min(total, samples);
+        sampleCount[p] = 0;
+        accum[p * 3] = accum[p * 3 + 1] = accum[p * 3 + 2] = 0.0f;
+    }
+}
+
+/// drop the samples of every pixel an edited object could show up in: its bounds, widened by
+/// its own size to take in contact shadows, projected to the screen with a few pixels to spare
+void invalidateBox(const aabb &box, camera cam, int image_height, int image_width, float *accum, int *sampleCount, int *historyWeight)
+{
+    vec3 extent = box.max() - box.min();
+    double margin = std::max(extent.x(), std::max(extent.y(), extent.z()));
+    point3 low = box.min() - vec3(margin, margin, margin);
+    point3 high = box.max() + vec3(margin, margin, margin);
+
+    int startColumn = 0, endColumn = image_width, startRow = 0, endRow = image_height;
+    double sMin = infinity, sMax = -infinity, tMin = infinity, tMax = -infinity;
+    bool inFront = true;
+
+    for (int c = 0; c < 8 && inFront; c++)
+    {
+        double s = 0, t = 0;
+        inFront = cam.project(point3(c & 1 ? high.x() : low.x(), c & 2 ? high.y() : low.y(), c & 4 ? high.z() : low.z()), s, t);
+        sMin = std::min(sMin, s);
+        sMax = std::max(sMax, s);
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+
+    /// a box reaching behind the camera can cover any part of the screen
+    if (inFront)
+    {
+        const int spare = 8;
+        startColumn = std::max(0, (int)(sMin * (image_width - 1)) - spare);
+        endColumn = std::min(image_width, (int)(sMax * (image_width - 1)) + spare + 1);
+        startRow = std::max(0, (int)(tMin * (image_height - 1)) - spare);
+        endRow = std::min(image_height, (int)(tMax * (image_height - 1)) + spare + 1);
+    }
+
+    for (int j = startRow; j < endRow; j++)
+    {
+        for (int i = startColumn; i < endColumn; i++)
+        {
+            int p = j * image_width + i;
+            sampleCount[p] = 0;
+            historyWeight[p] = 0;
+            accum[p * 3] = accum[p * 3 + 1] = accum[p * 3 + 2] = 0.0f;
+        }
+    }
+}
+
+/// serve a live preview on localhost: coarse 1/8, 1/4 and 1/2 resolution images first, then full resolution
+/// refined one sample per pass until samples_per_pixel; any camera move from the page starts over.
+/// With a watch, edits to the scene file are applied between passes: pixels where the edit shows directly
+/// start over, every other pixel is resampled too, showing a few samples' worth of its old value until it has new ones
+void renderPreview(const render_job &job, hittable_list &world, light_list &lights, scene_watch *watch)
+{
+    const int image_height = job.image_height;
+    const int image_width = job.image_width;
+    const int samples_per_pixel = job.samples_per_pixel;
+    const int threads = job.threads;
+    preview_server server(8080, point3(job.x, job.y, job.z));
+    if (!server.start())
+    {
+        std::cout << "Could not listen on port " << server.port << "\n";
+        return;
+    }
+    std::cout << "Preview at http://localhost:" << server.port << "/ (Ctrl+C to stop)\n";
+    if (watch)
+    {
+        std::cout << "Watching " << watch->fileName << " for changes\n";
+    }
+
+    std::thread *threadList = new std::thread[threads];
+    vector<float> accum((size_t)image_width * image_height * 3);
+    vector<int> sampleCount((size_t)image_width * image_height);
+    vector<float> history((size_t)image_width * image_height * 3);
+    vector<int> historyWeight((size_t)image_width * image_height);
+    vector<unsigned char> buffer((size_t)image_width * image_height * 3);
+    vector<string> lines;
+    int edits = 0;
+
+    while (true)
+    {
+        int generation = server.generation;
+        camera cam = job.cameraAt(server.lookfrom());
+        std::fill(accum.begin(), accum.end(), 0.0f);
+        std::fill(sampleCount.begin(), sampleCount.end(), 0);
+        std::fill(historyWeight.begin(), historyWeight.end(), 0);
+
+        /// coarse levels are a single pass each, then each pass adds a sample where one is missing
+        int pass = 0;
+        int passesLeft = 3 + samples_per_pixel;
+
+        while (server.generation == generation)
+        {
+            if (watch && watch->poll(lines))
+            {
+                vector<aabb> changed;
+                if (reloadWorld(*watch, lines, world, lights, changed))
+                {
+                    std::fill(accum.begin(), accum.end(), 0.0f);
+                    std::fill(sampleCount.begin(), sampleCount.end(), 0);
+                    std::fill(historyWeight.begin(), historyWeight.end(), 0);
+                }
+                else
+                {
+                    const int kept_samples = 4;
+                    keepHistory(image_width * image_height, kept_samples, accum.data(), sampleCount.data(), history.data(), historyWeight.data());
+                    for (const auto &box : changed)
+                    {
+                        invalidateBox(box, cam, image_height, image_width, accum.data(), sampleCount.data(), historyWeight.data());
+                    }
+                }
+                edits++;
+                passesLeft = std::max(passesLeft, samples_per_pixel);
+            }
+
+            if (passesLeft == 0)
+            {
+                /// converged: wait for a camera move or a scene edit
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            int scale = pass < 3 ? 8 >> pass : 1;
+            atomic<int> nextTile(0);
+
+            for (int i = 0; i < threads; i++)
+            {
+                threadList[i] = std::thread(previewPass, image_height, image_width, scale, pass, samples_per_pixel, job.max_depth, cam, std::cref(world), std::cref(lights), accum.data(), sampleCount.data(), history.data(), historyWeight.data(), buffer.data(), std::ref(nextTile), std::cref(server), generation, edits);
+            }
+
+            for (int i = 0; i < threads; i++)
+            {
+                threadList[i].join();
+            }
+
+            pass++;
+            passesLeft--;
+
+            if (server.generation == generation)
+            {
+                ostringstream bmp;
+                writeBitmapFile(bmp, buffer.data(), image_width, image_height);
+                server.publish(bmp.str());
+            }
+        }
+    }
+
+    delete[] threadList;
+}
+
+/// render the camera sweep one band of rows at a time, bottom first as bitmaps store them, and append
+/// each band to its file while the threads render the next one; memory stays at two bands at any resolution
+void renderStreamed(const render_job &job, const hittable_list &world, const light_list &lights, render_kernels kernels)
+{
+    const int band_height = 32;
+    const int image_height = job.image_height;
+    const int image_width = job.image_width;
+    const int images = job.images;
+    const int threads = job.threads;
+    std::thread *threadList = new std::thread[threads];
+    vector<unsigned char> bands[2] = {vector<unsigned char>((size_t)line_size * band_height), vector<unsigned char>((size_t)line_size * band_height)};
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    for (int c = 0; c < images; c++)
+    {
+        camera cam = job.sweepCamera(c);
+
+        ofstream outfile;
+        outfile.open(job.fileName(c), ios::binary | ios::out);
+        writeBitmapHeader(outfile, image_width, image_height);
+
+        int bandCount = (image_height + band_height - 1) / band_height;
+        for (int b = 0; b <= bandCount; b++)
+        {
+            atomic<int> nextTile(0);
+            int startRow = b * band_height;
+            int endRow = std::min(startRow + band_height, image_height);
+
+            if (b < bandCount)
+            {
+                for (int i = 0; i < threads; i++)
+                {
+                    threadList[i] = std::thread(kernels.renderBand, image_height, image_width, job.samples_per_pixel, job.max_depth, cam, std::cref(world), std::cref(lights), startRow, endRow, bands[b % 2].data(), std::ref(nextTile), c);
+                }
+            }
+
+            /// the previous band is written while this one renders
+            if (b > 0)
+            {
+                writeBitmapRows(outfile, bands[(b - 1) % 2].data(), image_width, std::min(band_height, image_height - (b - 1) * band_height));
+            }
+
+            if (b < bandCount)
+            {
+                for (int i = 0; i < threads; i++)
+                {
+                    threadList[i].join();
+                }
+            }
+        }
+
+        outfile.close();
+
+        auto renderTime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now() - t0);
+        std::cout << (c + 1) << "/" << images << " - render time: " << renderTime.count() << "s\n";
+    }
+
+    delete[] threadList;
+}
+
+/// the state shared by the workers of a multi-view job. Tiles are handed out round robin over a
+/// window of open views; a view closes once all its tiles are handed out and the next view opens,
+/// so only about window views hold a frame at any time
+struct view_batch
+{
+    vector<camera> views;
+    vector<string> fileNames;
+    vector<vector<unsigned char>> images; // allocated when a view's first tile is handed out
+    vector<atomic<int>> tilesLeft;        // per view, the worker finishing the last tile writes the image
+    mutex outputMutex;
+
+    int tilesPerView;
+    int window;
+    mutex dispatchMutex;
+    vector<int> open;       // views with tiles still to hand out
+    vector<int> tilesGiven; // per view
+    int nextView = 0;
+    int cursor = 0;
+
+    view_batch(const vector<camera> &cameras, const vector<string> &files, int tilesPerView, int window)
+        : views(cameras), fileNames(files), images(cameras.size()), tilesLeft(cameras.size()),
+          tilesPerView(tilesPerView), window(window), tilesGiven(cameras.size(), 0)
+    {
+        for (auto &left : tilesLeft)
+        {
+            left = tilesPerView;
+        }
+    }
+
+    /// the next tile to render, false when every tile is handed out
+    bool next(int frameSize, int &view, int &tile)
+    {
+        lock_guard<mutex> lock(dispatchMutex);
+        while ((int)open.size() < window && nextView < (int)views.size())
+        {
+            open.push_back(nextView++);
+        }
+        if (open.empty())
+        {
+            return false;
+        }
+
+        cursor %= (int)open.size();
+        view = open[cursor];
+        tile = tilesGiven[view]++;
+
+        if (tile == 0)
+        {
+            images[view].resize(frameSize);
+        }
+        if (tilesGiven[view] == tilesPerView)
+        {
+            open.erase(open.begin() + cursor);
+        }
+        else
+        {
+            cursor++;
+        }
+        return true;
+    }
+};
+
+/// worker of renderViews: renders whatever tile the batch hands out next, so the open views advance together
+void renderViewTiles(int image_height, int image_width, int samples_per_pixel, int max_depth, const hittable_list &world, const light_list &lights, render_kernels kernels, view_batch *batch)
+{
+    const int tile_size = 32;
+    int tilesX = (image_width + tile_size - 1) / tile_size;
+    int view, tile;
+
+    while (batch->next(line_size * image_height, view, tile))
+    {
+        int startColumn = (tile % tilesX) * tile_size;
+        int startRow = (tile / tilesX) * tile_size;
+        int endColumn = std::min(startColumn + tile_size, image_width);
+        int endRow = std::min(startRow + tile_size, image_height);
+
+        unsigned char *rows = &batch->images[view][(size_t)startRow * line_size];
+        kernels.renderTile(image_height, image_width, samples_per_pixel, max_depth, batch->views[view], world, lights, startColumn, endColumn, startRow, endRow, rows, view);
+
+        if (--batch->tilesLeft[view] == 0)
+        {
+            /// other workers may be writing their finished views at the same time
+            ofstream outfile;
+            outfile.open(batch->fileNames[view], ios::binary | ios::out);
+            writeBitmapFile(outfile, batch->images[view].data(), image_width, image_height);
+            outfile.close();
+            vector<unsigned char>().swap(batch->images[view]);
+
+            lock_guard<mutex> lock(batch->outputMutex);
+            std::cout << "image " << view << " done\n";
+        }
+    }
+}
+
+/// render the same scene from several cameras as one job: one set of threads working on tiles of
+/// twice as many views as threads at once, so no thread waits for the slowest part of a view while
+/// memory stays at about that many frames; each image is written as soon as its last tile is done
+void renderViews(int image_height, int image_width, int samples_per_pixel, int max_depth, const vector<camera> &views, const vector<string> &fileNames, const hittable_list &world, const light_list &lights, render_kernels kernels, int threads)
+{
+    const int tile_size = 32;
+    int tilesPerView = ((image_width + tile_size - 1) / tile_size) * ((image_height + tile_size - 1) / tile_size);
+    view_batch batch(views, fileNames, tilesPerView, 2 * threads);
+
+    std::thread *threadList = new std::thread[threads];
+    for (int i = 0; i < threads; i++)
+    {
+        threadList[i] = std::thread(renderViewTiles, image_height, image_width, samples_per_pixel, max_depth, std::cref(world), std::cref(lights), kernels, &batch);
+    }
+
+    for (int i = 0; i < threads; i++)
+    {
+        threadList[i].join();
+    }
+
+    delete[] threadList;
+}
+
+/// a copy of the scene whose pages live on one numa node
+struct node_scene
+{
+    hittable_list world;
+    light_list lights;
+};
+
+/// pin the calling thread to cpu; when that fails the thread runs unpinned, which is said once
+void pinWorker(int cpu)
+{
+    static atomic<bool> reported(false);
+    if (!pinThread(cpu) && !reported.exchange(true))
+    {
+        std::cout << "Could not pin a thread to processor " << cpu << ", threads that cannot be pinned run anywhere and their memory may be on another node\n";
+    }
+}
+
+/// copy the scene objects and build their bvh on a thread pinned to the node, so first touch
+/// places everything there; materials and instanced prototypes stay shared, and as hit records
+/// point at materials without owning them, workers only ever read them
+void replicateWorld(const hittable_list &objects, int cpu, node_scene *replica)
+{
+    pinWorker(cpu);
+
+    hittable_list copy;
+    for (const auto &object : objects.objects)
+    {
+        if (auto s = std::dynamic_pointer_cast<sphere>(object))
+        {
+            copy.add(make_shared<sphere>(*s));
+        }
+        else if (auto s = std::dynamic_pointer_cast<moving_sphere>(object))
+        {
+            copy.add(make_shared<moving_sphere>(*s));
+        }
+        else if (auto m = std::dynamic_pointer_cast<triangle_mesh>(object))
+        {
+            copy.add(make_shared<triangle_mesh>(*m));
+        }
+        else
+        {
+            copy.add(object);
+        }
+    }
+
+    replica->lights = light_list(copy);
+    replica->world = copy.objects.empty() ? copy : hittable_list(make_shared<bvh_node>(copy, 0.0, 1.0, 1));
+}
+
+/// one pinned worker of --numa: renders 32-row bands from its node's block of rows with its node's scene.
+/// Before the first frame it touches the pages it will write, so they are placed on its node
+void renderNumaWorker(int image_height, int image_width, int samples_per_pixel, int max_depth, camera cam, const node_scene &scene, render_kernels kernels, int cpu, int startRow, int endRow, atomic<int> &nextBand, int frame, bool firstTouch)
+{
+    const int band_height = 32;
+    pinWorker(cpu);
+
+    for (int b = nextBand++; startRow + b * band_height < endRow; b = nextBand++)
+    {
+        int bandStart = startRow + b * band_height;
+        int bandEnd = std::min(bandStart + band_height, endRow);
+        unsigned char *band = &img[(size_t)bandStart * line_size];
+
+        if (firstTouch)
+        {
+            std::fill(band, band + (size_t)(bandEnd - bandStart) * line_size, 0);
+        }
+
+        atomic<int> nextTile(0);
+        kernels.renderBand(image_height, image_width, samples_per_pixel, max_depth, cam, scene.world, scene.lights, bandStart, bandEnd, band, nextTile, frame);
+    }
+}
+
+/// time a small frame with the generic kernel, then with each feature the scene lets the kernel drop,
+/// one after the other; every kernel must give the generic kernel's image
+void benchmarkKernels(const render_job &job, const hittable_list &world, const light_list &lights, int features)
+{
+    const int image_width = 192;
+    const int image_height = static_cast<int>(image_width / job.aspect_ratio);
+    const int samples = 8;
+    const int runs = 5;
+    const int max_depth = job.max_depth;
+    camera cam = job.sweepCamera(0);
+
+    const char *names[] = {"generic", "no emission", "lambertian only"};
+    int masks[3];
+    masks[0] = feature_emission;
+    masks[1] = masks[0] & ~(features & feature_emission ? 0 : feature_emission);
+    masks[2] = masks[1] | (features & feature_lambertian_only);
+
+    vector<float> reference;
+    double genericTime = 0;
+
+    for (int k = 0; k < 3; k++)
+    {
+        if (k > 0 && masks[k] == masks[k - 1])
+        {
+            std::cout << names[k] << ": not possible for this scene\n";
+            continue;
+        }
+
+        /// best of a few runs, the same image every time
+        vector<float> accum;
+        double time = infinity;
+        for (int run = 0; run < runs; run++)
+        {
+            accum.assign((size_t)image_width * image_height * 3, 0.0f);
+            uint64_t rngState = seeded_state(1);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            selectKernels(masks[k]).renderPass(image_height, image_width, samples, max_depth, cam, world, lights, 0, image_width, accum.data(), &rngState, 0, 0);
+            time = std::min(time, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+
+        if (k == 0)
+        {
+            reference = accum;
+            genericTime = time;
+        }
+
+        std::cout << names[k] << ": " << time << "ms, " << genericTime / time << "x" << (accum == reference ? "" : " (image differs)") << "\n";
+    }
+}
+
+/// closest-hit throughput on camera rays and on the bounce rays they spawn
+void benchmarkIntersection(const hittable_list &world, camera cam)
+{
+    const int rays = 1 << 20;
+    vector<ray> primary(rays), secondary;
+    secondary.reserve(rays);
+
+    seed_random(1);
+    for (int k = 0; k < rays; k++)
+    {
+        primary[k] = cam.get_ray(random_double(), random_double());
+    }
+
+    using std::chrono::high_resolution_clock;
+    hit_record rec;
+    int hits = 0;
+
+    auto t0 = high_resolution_clock::now();
+    for (const auto &r : primary)
+    {
+        if (world.hit(r, 0.001, infinity, rec))
+        {
+            ++hits;
+            secondary.push_back(ray(rec.p, rec.normal + random_unit_vector(), r.time()));
+        }
+    }
+    auto t1 = high_resolution_clock::now();
+    for (const auto &r : secondary)
+    {
+        world.hit(r, 0.001, infinity, rec);
+    }
+    auto t2 = high_resolution_clock::now();
+
+    auto primaryTime = std::chrono::duration<double>(t1 - t0).count();
+    auto secondaryTime = std::chrono::duration<double>(t2 - t1).count();
+    std::cout << "primary rays: " << rays / primaryTime / 1e6 << " Mrays/s (" << hits << " hits)\n";
+    std::cout << "bounce rays: " << secondary.size() / secondaryTime / 1e6 << " Mrays/s\n";
+}
+
+int main(int argc, char *argv[])
+{
+    /// --checkpoint saves progress periodically, --resume also continues from the last checkpoint
+    bool useCheckpoints = false;
+    bool resume = false;
+    /// --bench-hit measures intersection throughput on the chosen scene and exits
+    bool benchHit = false;
+    /// --bench-kernels times the specialized render kernels for the chosen scene against the generic one and exits
+    bool benchKernels = false;
+    /// --preview serves a progressive, steerable render on localhost instead of writing images
+    bool preview = false;
+    /// --watch also applies edits to input.txt to the running preview
+    bool watchScene = false;
+    /// --stream writes each image band by band as it renders, so memory does not grow with the resolution
+    bool streamOutput = false;
+    /// --numa pins workers node by node, gives every numa node its own copy of the scene and
+    /// lets each node first-touch the rows of the image it renders
+    bool useNuma = false;
+    /// --batch renders every image of the sweep as views of one job
+    bool batchViews = false;
+    /// --width <pixels> sets the output width, the height follows the aspect ratio
+    int outputWidth = 720;
+    /// --spp <samples> sets the samples per pixel
+    int outputSamples = 100;
+    for (int a = 1; a < argc; a++)
+    {
+        string arg = argv[a];
+        if (arg == "--bench-hit")
+        {
+            benchHit = true;
+        }
+        else if (arg == "--preview")
+        {
+            preview = true;
+        }
+        else if (arg == "--batch")
+        {
+            batchViews = true;
+        }
+        else if (arg == "--numa")
+        {
+            useNuma = true;
+        }
+        else if (arg == "--stream")
+        {
+            streamOutput = true;
+        }
+        else if (arg == "--width" && a + 1 < argc)
+        {
+            outputWidth = std::max(1, atoi(argv[++a]));
+        }
+        else if (arg == "--spp" && a + 1 < argc)
+        {
+            outputSamples = std::max(1, atoi(argv[++a]));
+        }
+        else if (arg == "--watch")
+        {
+            preview = true;
+            watchScene = true;
+        }
+        else if (arg == "--bench-kernels")
+        {
+            benchKernels = true;
+        }
+        else if (arg == "--checkpoint")
+        {
+            useCheckpoints = true;
+        }
+        else if (arg == "--resume")
+        {
+            useCheckpoints = true;
+            resume = true;
+        }
+    }
+
+    // Image
+    const auto aspect_ratio = 16.0 / 9.0;
+    const int image_width = outputWidth;
+    const int image_height = static_cast<int>(image_width / aspect_ratio);
+    const int samples_per_pixel = outputSamples;
+    const int max_depth = 5;
+
+    cel_size = sizeof(unsigned char) * 3;
+    line_size = cel_size * image_width;
+
+    /// streamed images never hold a whole frame
+    if (!streamOutput)
+    {
+        img = new unsigned char[(size_t)line_size * image_height];
+    }
+
+    // Read world from file
+    hittable_list world;
+    shared_ptr<scene_watch> watch;
+    string readWorldFromFile;
+    std::cout << "Read input file? [Y] / [N] / [I]nstanced clusters: ";
+    std::cin >> readWorldFromFile;
+
+    /// checkpoints only resume the scene they were taken from
+    uint64_t sceneHash = hashBytes(string(1, (char)toupper(readWorldFromFile[0])));
+
+    if (readWorldFromFile == "Y" || readWorldFromFile == "y")
+    {
+        ifstream sceneFile("input.txt", ios::binary);
+        sceneHash = hashBytes(string(istreambuf_iterator<char>(sceneFile), istreambuf_iterator<char>()), sceneHash);
+
+        if (watchScene)
+        {
+            watch = make_shared<scene_watch>("input.txt");
+        }
+        world = readWorld("input.txt", watch.get());
+    }
+    else if (readWorldFromFile == "N" || readWorldFromFile == "n")
+    {
+        world = random_scene();
+    }
+    else if (readWorldFromFile == "I" || readWorldFromFile == "i")
+    {
+        world = instanced_scene();
+    }
+
+    /// emissive spheres are sampled directly
+    light_list lights(world);
+
+    /// a scene where nothing moves gets a zero-length shutter, so cameras skip the time sample
+    double shutterClose = 0.0;
+    for (const auto &object : world.objects)
+    {
+        if (std::dynamic_pointer_cast<moving_sphere>(object))
+        {
+            shutterClose = 1.0;
+        }
+    }
+
+    /// render kernels drop what the scene does not use
+    int features = sceneFeatures(world);
+
+    /// the objects before they go under the bvh, for per-node copies
+    hittable_list sceneObjects = world;
+
+    /// top-level bvh over the scene objects
+    shared_ptr<bvh_node> sceneBvh;
+    if (!world.objects.empty())
+    {
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        sceneBvh = make_shared<bvh_node>(world, 0.0, 1.0);
+        auto buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart);
+        std::cout << "BVH build over " << world.objects.size() << " objects: " << buildTime.count() << "ms\n";
+
+        world = hittable_list(sceneBvh);
+    }
+
+    if (watch)
+    {
+        watch->bvh = sceneBvh;
+    }
+    else if (watchScene)
+    {
+        std::cout << "Only a scene read from the input file can be watched\n";
+    }
+
+    // Camera
+    point3 lookfrom(13, 2, 3);
+    point3 lookat(0, 0, 0);
+    vec3 vup(0, 1, 0);
+    auto dist_to_focus = 10.0;
+    auto aperture = 0.1;
+
+    camera cam(lookfrom, lookat, vup, 20, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
+
+    render_kernels kernels = selectKernels(features);
+
+    /// the camera sweep starts at (x, y, z) and moves along x
+    render_job job;
+    job.image_height = image_height;
+    job.image_width = image_width;
+    job.samples_per_pixel = samples_per_pixel;
+    job.max_depth = max_depth;
+    job.x = 5;
+    job.y = 1;
+    job.z = 2;
+    job.aspect_ratio = aspect_ratio;
+    job.aperture = aperture;
+    job.dist_to_focus = dist_to_focus;
+    job.shutterClose = shutterClose;
+    job.imgPreffix = "images/image";
+    job.imgSuffix = ".bmp";
+
+    if (benchKernels)
+    {
+        benchmarkKernels(job, world, lights, features);
+        return 0;
+    }
+
+    if (benchHit)
+    {
+        benchmarkIntersection(world, cam);
+        return 0;
+    }
+
+    // Render
+    std::thread *threadList;
+    int threads;
+
+    std::cout << "Threads to use: ";
+    std::cin >> threads;
+    job.threads = threads;
+
+    if (preview)
+    {
+        renderPreview(job, world, lights, watch.get());
+        return 0;
+    }
+
+    threadList = new std::thread[threads];
+    int pixel_per_thread = (image_width / threads);
+
+    double images;
+    std::cout << "Images to render: ";
+    std::cin >> images;
+    job.images = (int)images;
+    job.moveSize = (job.x * 2) / images;
+
+    if (streamOutput)
+    {
+        if (useNuma)
+        {
+            std::cout << "NUMA placement is not used when streaming\n";
+        }
+        std::cout << "Streaming " << images << " images of " << image_width << "x" << image_height << " with " << threads << " threads\n";
+        renderStreamed(job, world, lights, kernels);
+        return 0;
+    }
+
+    /// split each frame across threads, or give each thread whole frames
+    string renderFrameParallel;
+    std::cout << "Render whole frames per thread? [Y] / [N]: ";
+    std::cin >> renderFrameParallel;
+
+    string denoiseImages;
+    std::cout << "Denoise images? [Y] / [N]: ";
+    std::cin >> denoiseImages;
+    bool denoiseImage = (denoiseImages == "Y" || denoiseImages == "y");
+    job.denoiseImage = denoiseImage;
+
+    /// get time before start rendering
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::seconds;
+    auto t0 = high_resolution_clock::now();
+    auto t1 = t0;
+    auto sumRenderTime = duration_cast<seconds>(t1 - t0);
+
+    std::cout << "Rendering " << images << " images with " << threads << " threads\n";
+
+    if (renderFrameParallel == "Y" || renderFrameParallel == "y")
+    {
+        atomic<int> nextFrame(0);
+        mutex outputMutex;
+
+        if (useNuma)
+        {
+            std::cout << "NUMA placement is not used with whole frames per thread\n";
+        }
+
+        for (int i = 0; i < threads; i++)
+        {
+            threadList[i] = std::thread(renderFrames, std::cref(job), std::cref(world), std::cref(lights), kernels, std::ref(nextFrame), std::ref(outputMutex));
+        }
+
+        for (int i = 0; i < threads; i++)
+        {
+            threadList[i].join();
+        }
+
+        /// get time after all frames
+        t1 = high_resolution_clock::now();
+        sumRenderTime = duration_cast<seconds>(t1 - t0);
+        std::cout << images << "/" << images << " - render time: " << sumRenderTime.count() << "s\n";
+
+        return 0;
+    }
+
+    if (useCheckpoints)
+    {
+        if (useNuma)
+        {
+            std::cout << "NUMA placement is not used with checkpoints\n";
+        }
+        renderWithCheckpoints(job, world, lights, kernels, resume, sceneHash, job.imgPreffix + ".checkpoint");
+        return 0;
+    }
+
+    if (batchViews && !denoiseImage)
+    {
+        if (useNuma)
+        {
+            std::cout << "NUMA placement is not used with --batch\n";
+        }
+
+        vector<camera> views;
+        vector<string> fileNames;
+        for (int c = 0; c < images; c++)
+        {
+            views.push_back(job.sweepCamera(c));
+            fileNames.push_back(job.fileName(c));
+        }
+
+        renderViews(image_height, image_width, samples_per_pixel, max_depth, views, fileNames, world, lights, kernels, threads);
+
+        sumRenderTime = duration_cast<seconds>(high_resolution_clock::now() - t0);
+        std::cout << images << "/" << images << " - render time: " << sumRenderTime.count() << "s\n";
+        return 0;
+    }
+    else if (batchViews)
+    {
+        std::cout << "Views are rendered one at a time with the denoiser\n";
+    }
+
+    /// --numa: a scene copy per node in use, and a block of rows per node sized by its worker count
+    vector<node_scene> replicas;
+    vector<int> workerNode(threads), workerCpu(threads), nodeStart, nodeEnd;
+    if (useNuma && denoiseImage)
+    {
+        std::cout << "NUMA placement is not used with the denoiser\n";
+    }
+    else if (useNuma)
+    {
+        numa_topology topology = detectTopology();
+        int nodesUsed = 0;
+        for (int i = 0; i < threads; i++)
+        {
+            topology.place(i, workerNode[i], workerCpu[i]);
+            nodesUsed = std::max(nodesUsed, workerNode[i] + 1);
+        }
+
+        auto replicateStart = high_resolution_clock::now();
+        replicas.resize(nodesUsed);
+        for (int n = 0; n < nodesUsed; n++)
+        {
+            threadList[n] = std::thread(replicateWorld, std::cref(sceneObjects), topology.nodes[n][0], &replicas[n]);
+        }
+        for (int n = 0; n < nodesUsed; n++)
+        {
+            threadList[n].join();
+        }
+        auto replicateTime = std::chrono::duration<double, std::milli>(high_resolution_clock::now() - replicateStart);
+
+        int workersBefore = 0;
+        for (int n = 0; n < nodesUsed; n++)
+        {
+            int workers = (int)std::count(workerNode.begin(), workerNode.end(), n);
+            nodeStart.push_back(image_height * workersBefore / threads);
+            workersBefore += workers;
+            nodeEnd.push_back(image_height * workersBefore / threads);
+            std::cout << "NUMA node " << topology.ids[n] << ": " << workers << " workers, rows " << nodeStart[n] << "-" << nodeEnd[n] << "\n";
+        }
+        std::cout << "Scene copied to " << nodesUsed << " of " << topology.nodes.size() << " nodes in " << replicateTime.count() << "ms\n";
+    }
+
+    for (int c = 0; c < images; c++)
+    {
+        camera cam = job.sweepCamera(c);
+
+        if (denoiseImage)
+        {
+            /// the denoiser needs the float frame, so accumulate before quantizing
+            vector<float> accum((size_t)image_width * image_height * 3, 0.0f);
+            vector<uint64_t> rngStates(threads);
+
+            for (int i = 0; i < threads; i++)
+            {
+                int endColumn = (i == threads - 1) ? image_width : (pixel_per_thread * i) + pixel_per_thread;
+                rngStates[i] = seeded_state((uint64_t)c * image_width + pixel_per_thread * i);
+                threadList[i] = std::thread(kernels.renderPass, image_height, image_width, samples_per_pixel, max_depth, cam, std::cref(world), std::cref(lights), pixel_per_thread * i, endColumn, accum.data(), &rngStates[i], c, 0);
+            }
+
+            for (int i = 0; i < threads; i++)
+            {
+                threadList[i].join();
+            }
+
+            resolveImage(accum.data(), samples_per_pixel, image_height, image_width, cam, world, true, threads, img);
+        }
+        else if (!replicas.empty())
+        {
+            vector<atomic<int>> nextBand(replicas.size());
+            for (auto &band : nextBand)
+            {
+                band = 0;
+            }
+
+            for (int i = 0; i < threads; i++)
+            {
+                int n = workerNode[i];
+                threadList[i] = std::thread(renderNumaWorker, image_height, image_width, samples_per_pixel, max_depth, cam, std::cref(replicas[n]), kernels, workerCpu[i], nodeStart[n], nodeEnd[n], std::ref(nextBand[n]), c, c == 0);
+            }
+
+            for (int i = 0; i < threads; i++)
+            {
+                threadList[i].join();
+            }
+        }
+        else
+        {
+            for (int i = 0; i < threads; i++)
+            {
+                if (i == threads - 1)
+                {
+                    threadList[i] = std::thread(kernels.render, image_height, image_width, samples_per_pixel, max_depth, cam, world, std::cref(lights), pixel_per_thread * i, image_width, img, c);
+                }
+                else
+                {
+                    threadList[i] = std::thread(kernels.render, image_height, image_width, samples_per_pixel, max_depth, cam, world, std::cref(lights), pixel_per_thread * i, (pixel_per_thread * i) + pixel_per_thread, img, c);
+                }
+            }
+
+            for (int i = 0; i < threads; i++)
+            {
+                threadList[i].join();
+            }
+        }
 
         /// get time after each render
         t1 = high_resolution_clock::now();
@@ -326,7 +2012,7 @@ int main()
         std::cout << " - render time: " << sumRenderTime.count() << "s\n";
 
         ofstream outfile;
-        outfile.open(imgPreffix + to_string(c) + imgSuffix, ios::binary | ios::out);
+        outfile.open(job.fileName(c), ios::binary | ios::out);
         writeBitmapFile(outfile, image_width, image_height);
         outfile.close();
     }
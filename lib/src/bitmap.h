@@ -6,9 +6,11 @@
 // Description : Hello World in C++, Ansi-style
 //============================================================================
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <vector>
 
 using namespace std;
 
@@ -19,11 +21,13 @@ unsigned char *img;
 int line_size;
 int cel_size;
 
-char *createBitmapFileHeader(int height, int width, int paddingSize)
+/// returned by value, several threads may write bitmaps at once
+array<unsigned char, fileHeaderSize> createBitmapFileHeader(int height, int width, int paddingSize)
 {
-	int fileSize = fileHeaderSize + infoHeaderSize + (bytesPerPixel * width + paddingSize) * height;
+	/// only the low 32 bits fit, readers go by the info header for larger images
+	long long fileSize = fileHeaderSize + infoHeaderSize + (long long)(bytesPerPixel * width + paddingSize) * height;
 
-	static unsigned char fileHeader[] = {
+	array<unsigned char, fileHeaderSize> fileHeader = {
 		0, 0,		/// signature
 		0, 0, 0, 0, /// image file size in bytes
 		0, 0, 0, 0, /// reserved
@@ -38,12 +42,12 @@ char *createBitmapFileHeader(int height, int width, int paddingSize)
 	fileHeader[5] = (unsigned char)(fileSize >> 24);
 	fileHeader[10] = (unsigned char)(fileHeaderSize + infoHeaderSize);
 
-	return (char *)fileHeader;
+	return fileHeader;
 }
 
-char *createBitmapInfoHeader(int height, int width)
+array<unsigned char, infoHeaderSize> createBitmapInfoHeader(int height, int width)
 {
-	static unsigned char infoHeader[] = {
+	array<unsigned char, infoHeaderSize> infoHeader = {
 		0, 0, 0, 0, /// header size
 		0, 0, 0, 0, /// image width
 		0, 0, 0, 0, /// image height
@@ -69,31 +73,49 @@ char *createBitmapInfoHeader(int height, int width)
 	infoHeader[12] = (unsigned char)(1);
 	infoHeader[14] = (unsigned char)(bytesPerPixel * 8);
 
-	return (char *)infoHeader;
+	return infoHeader;
 }
 
-void writeBitmapFile(ofstream &out, int width, int height)
+/// headers of a bitmap whose rows follow, bottom row first
+void writeBitmapHeader(ostream &out, int width, int height)
 {
-	char padding[3] = {0, 0, 0};
-	char color[3] = {0, 0, 0};
 	int paddingSize = (4 - (width * bytesPerPixel) % 4) % 4;
 
-	char *fileHeader = createBitmapFileHeader(height, width, paddingSize);
-	char *infoHeader = createBitmapInfoHeader(height, width);
+	array<unsigned char, fileHeaderSize> fileHeader = createBitmapFileHeader(height, width, paddingSize);
+	array<unsigned char, infoHeaderSize> infoHeader = createBitmapInfoHeader(height, width);
+
+	out.write((char *)fileHeader.data(), fileHeaderSize);
+	out.write((char *)infoHeader.data(), infoHeaderSize);
+}
 
-	out.write((char *)fileHeader, fileHeaderSize);
-	out.write((char *)infoHeader, infoHeaderSize);
+/// append rows of rgb pixels, bottom row first, to a bitmap started by writeBitmapHeader
+void writeBitmapRows(ostream &out, const unsigned char *buffer, int width, int rows)
+{
+	char padding[3] = {0, 0, 0};
+	int paddingSize = (4 - (width * bytesPerPixel) % 4) % 4;
+	vector<char> line(width * bytesPerPixel);
 
-	for (int y = height; y > 0; y--)
+	for (int y = 0; y < rows; y++)
 	{
+		const unsigned char *row = buffer + (size_t)y * width * bytesPerPixel;
 		for (int x = 0; x < width; x++)
 		{
-			int p = (height - y) * line_size + x * cel_size;
-			color[2] = img[p];
-			color[1] = img[p + 1];
-			color[0] = img[p + 2];
-			out.write(color, sizeof(color));
+			line[x * 3] = row[x * 3 + 2];
+			line[x * 3 + 1] = row[x * 3 + 1];
+			line[x * 3 + 2] = row[x * 3];
 		}
+		out.write(line.data(), line.size());
 		out.write(padding, paddingSize);
 	}
+}
+
+void writeBitmapFile(ostream &out, const unsigned char *buffer, int width, int height)
+{
+	writeBitmapHeader(out, width, height);
+	writeBitmapRows(out, buffer, width, height);
+}
+
+void writeBitmapFile(ofstream &out, int width, int height)
+{
+	writeBitmapFile(out, img, width, height);
 }
\ No newline at end of file
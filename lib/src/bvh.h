@@ -0,0 +1,183 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "sah.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/// an object with its bounds cached, so the build never asks for them twice
+struct bvh_primitive
+{
+    shared_ptr<hittable> object;
+    aabb box;
+    point3 centroid;
+};
+
+class bvh_node : public hittable
+{
+public:
+    bvh_node() {}
+
+    bvh_node(const hittable_list &list, double time0, double time1, int threads = 0)
+        : bvh_node(make_primitives(list.objects, time0, time1), time0, time1, threads)
+    {
+    }
+
+    bvh_node(std::vector<bvh_primitive> primitives, double time0, double time1, int threads = 0)
+    {
+        if (threads <= 0)
+            threads = std::max(1, (int)std::thread::hardware_concurrency());
+        build(primitives, 0, primitives.size(), threads - 1);
+    }
+
+    virtual bool intersect(
+        const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+    virtual bool occluded(const ray &r, double t_min, double t_max) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
+    /// recompute every box bottom-up for objects that moved, keeping the tree shape
+    void refit(double time0, double time1);
+
+    static std::vector<bvh_primitive> make_primitives(
+        const std::vector<shared_ptr<hittable>> &objects, double time0, double time1);
+
+private:
+    bvh_node(std::vector<bvh_primitive> &primitives, size_t start, size_t end, int spare_threads)
+    {
+        build(primitives, start, end, spare_threads);
+    }
+
+    void build(std::vector<bvh_primitive> &primitives, size_t start, size_t end, int spare_threads);
+    size_t split(std::vector<bvh_primitive> &primitives, size_t start, size_t end) const;
+
+public:
+    shared_ptr<hittable> left;
+    shared_ptr<hittable> right;
+    aabb box;
+};
+
+std::vector<bvh_primitive> bvh_node::make_primitives(
+    const std::vector<shared_ptr<hittable>> &objects, double time0, double time1)
+{
+    std::vector<bvh_primitive> primitives(objects.size());
+
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        primitives[i].object = objects[i];
+        if (!objects[i]->bounding_box(time0, time1, primitives[i].box))
+            std::cerr << "No bounding box in bvh_node constructor.\n";
+        primitives[i].centroid = 0.5 * (primitives[i].box.min() + primitives[i].box.max());
+    }
+
+    return primitives;
+}
+
+size_t bvh_node::split(std::vector<bvh_primitive> &primitives, size_t start, size_t end) const
+{
+    return sah_split(
+        primitives, start, end,
+        [](const bvh_primitive &p) -> const aabb &
+        { return p.box; },
+        [](const bvh_primitive &p) -> const point3 &
+        { return p.centroid; });
+}
+
+void bvh_node::build(std::vector<bvh_primitive> &primitives, size_t start, size_t end, int spare_threads)
+{
+    const size_t parallel_threshold = 4096;
+
+    box = primitives[start].box;
+    for (size_t i = start; i < end; i++)
+    {
+        box = surrounding_box(box, primitives[i].box);
+    }
+
+    size_t object_span = end - start;
+
+    if (object_span == 1)
+    {
+        left = right = primitives[start].object;
+    }
+    else if (object_span == 2)
+    {
+        left = primitives[start].object;
+        right = primitives[start + 1].object;
+    }
+    else
+    {
+        auto mid = split(primitives, start, end);
+
+        /// the two halves touch disjoint ranges, so big ones are built side by side
+        if (spare_threads > 0 && object_span > parallel_threshold)
+        {
+            int left_threads = (spare_threads - 1) / 2;
+            int right_threads = spare_threads - 1 - left_threads;
+            bvh_node *left_node = nullptr;
+
+            std::thread worker([&]()
+                               { left_node = new bvh_node(primitives, start, mid, left_threads); });
+            right = shared_ptr<bvh_node>(new bvh_node(primitives, mid, end, right_threads));
+            worker.join();
+            left = shared_ptr<bvh_node>(left_node);
+        }
+        else
+        {
+            left = shared_ptr<bvh_node>(new bvh_node(primitives, start, mid, 0));
+            right = shared_ptr<bvh_node>(new bvh_node(primitives, mid, end, 0));
+        }
+    }
+}
+
+void bvh_node::refit(double time0, double time1)
+{
+    aabb box_left, box_right;
+
+    if (auto node = dynamic_cast<bvh_node *>(left.get()))
+        node->refit(time0, time1);
+    if (right != left)
+    {
+        if (auto node = dynamic_cast<bvh_node *>(right.get()))
+            node->refit(time0, time1);
+    }
+
+    if (!left->bounding_box(time0, time1, box_left) || !right->bounding_box(time0, time1, box_right))
+        std::cerr << "No bounding box in bvh_node::refit.\n";
+
+    box = surrounding_box(box_left, box_right);
+}
+
+bool bvh_node::intersect(const ray &r, double t_min, double t_max, hit_record &rec) const
+{
+    if (!box.hit(r, t_min, t_max))
+        return false;
+
+    bool hit_left = left->intersect(r, t_min, t_max, rec);
+    bool hit_right = right != left && right->intersect(r, t_min, hit_left ? rec.t : t_max, rec);
+
+    return hit_left || hit_right;
+}
+
+bool bvh_node::occluded(const ray &r, double t_min, double t_max) const
+{
+    if (!box.hit(r, t_min, t_max))
+        return false;
+
+    return left->occluded(r, t_min, t_max) || (right != left && right->occluded(r, t_min, t_max));
+}
+
+bool bvh_node::bounding_box(double time0, double time1, aabb &output_box) const
+{
+    output_box = box;
+    return true;
+}
+
+#endif
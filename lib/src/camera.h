@@ -46,6 +46,70 @@ public:
             random_double(time0, time1));
     }
 
+    // Ray from given sample values in [0,1) for the lens and the shutter. A pinhole camera
+    // skips the lens and a zero-length shutter skips the time.
+    ray get_ray(double s, double t, double lens_s, double lens_t, double time_s) const
+    {
+        vec3 direction = lower_left_corner + s * horizontal + t * vertical - origin;
+        double time = time0 == time1 ? time0 : time0 + time_s * (time1 - time0);
+
+        if (lens_radius == 0)
+            return ray(origin, direction, time);
+
+        vec3 rd = lens_radius * concentric_disk(lens_s, lens_t);
+        vec3 offset = u * rd.x() + v * rd.y();
+
+        return ray(origin + offset, direction - offset, time);
+    }
+
+    // Screen position (s, t) of a point seen through the lens center; false when the point is
+    // not in front of the camera.
+    bool project(const point3 &p, double &s, double &t) const
+    {
+        vec3 d = p - origin;
+        double depth = -dot(d, w);
+        if (depth <= 0)
+            return false;
+
+        // Scale onto the focus plane, where horizontal and vertical span the screen.
+        vec3 q = d * (dot(origin - lower_left_corner, w) / depth);
+        s = 0.5 + dot(q, horizontal) / horizontal.length_squared();
+        t = 0.5 + dot(q, vertical) / vertical.length_squared();
+        return true;
+    }
+
+private:
+    // Maps the unit square onto the unit disk without rejection, keeping strata intact.
+    static vec3 concentric_disk(double s, double t)
+    {
+        double a = 2 * s - 1;
+        double b = 2 * t - 1;
+        if (a == 0 && b == 0)
+            return vec3(0, 0, 0);
+
+        // The angle is pi/4 * ratio (or pi/2 minus that), so only |phi| <= pi/4 needs a sine
+        // and cosine, and a short series is exact to about 1e-9 there.
+        double r, ratio;
+        bool steep = fabs(a) <= fabs(b);
+        if (!steep)
+        {
+            r = a;
+            ratio = b / a;
+        }
+        else
+        {
+            r = b;
+            ratio = a / b;
+        }
+
+        double phi = (pi / 4) * ratio;
+        double p2 = phi * phi;
+        double sin_phi = phi * (1 - p2 / 6 * (1 - p2 / 20 * (1 - p2 / 42 * (1 - p2 / 72))));
+        double cos_phi = 1 - p2 / 2 * (1 - p2 / 12 * (1 - p2 / 30 * (1 - p2 / 56 * (1 - p2 / 90))));
+
+        return steep ? vec3(r * sin_phi, r * cos_phi, 0) : vec3(r * cos_phi, r * sin_phi, 0);
+    }
+
 private:
     point3 origin;
     point3 lower_left_corner;
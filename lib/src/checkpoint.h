@@ -0,0 +1,129 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+/// progress of a column-mode render, enough to continue it bit-for-bit
+struct checkpoint
+{
+    int image_width = 0;
+    int image_height = 0;
+    int samples_per_pixel = 0;
+    int images = 0;
+    int threads = 0;
+    uint64_t scene_hash = 0; // which scene the samples belong to
+
+    int frame = 0;   // frame being rendered
+    int samples = 0; // samples already accumulated into every pixel of that frame
+    double x = 0;    // camera position along the sweep
+
+    std::vector<float> accum;         // linear rgb sums, 3 per pixel
+    std::vector<uint64_t> rng_states; // one random stream per column band
+
+    bool matches(int width, int height, int spp, int imageCount, int threadCount, uint64_t scene) const
+    {
+        return image_width == width && image_height == height && samples_per_pixel == spp &&
+               images == imageCount && threads == threadCount && scene_hash == scene;
+    }
+};
+
+const uint32_t checkpointMagic = 0x50435452; // "RTCP"
+const uint32_t checkpointVersion = 2;
+
+/// FNV-1a, to tell scenes apart
+inline uint64_t hashBytes(const std::string &bytes, uint64_t hash = 14695981039346656037ULL)
+{
+    for (unsigned char c : bytes)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+void writeValue(std::ofstream &out, const T &value)
+{
+    out.write((const char *)&value, sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream &in, T &value)
+{
+    return (bool)in.read((char *)&value, sizeof(T));
+}
+
+/// write to a temporary file first and swap it in with one atomic rename, so a kill at any
+/// point leaves either the previous checkpoint or the new one
+bool saveCheckpoint(const std::string &fileName, const checkpoint &cp)
+{
+    std::string tmpName = fileName + ".tmp";
+    std::ofstream out(tmpName, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!out)
+        return false;
+
+    writeValue(out, checkpointMagic);
+    writeValue(out, checkpointVersion);
+    writeValue(out, cp.image_width);
+    writeValue(out, cp.image_height);
+    writeValue(out, cp.samples_per_pixel);
+    writeValue(out, cp.images);
+    writeValue(out, cp.threads);
+    writeValue(out, cp.scene_hash);
+    writeValue(out, cp.frame);
+    writeValue(out, cp.samples);
+    writeValue(out, cp.x);
+    out.write((const char *)cp.accum.data(), cp.accum.size() * sizeof(float));
+    out.write((const char *)cp.rng_states.data(), cp.rng_states.size() * sizeof(uint64_t));
+    out.close();
+
+    if (!out)
+        return false;
+
+#ifdef _WIN32
+    return MoveFileExA(tmpName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+#endif
+}
+
+bool loadCheckpoint(const std::string &fileName, checkpoint &cp)
+{
+    std::ifstream in(fileName, std::ios::binary | std::ios::in);
+    uint32_t magic, version;
+
+    if (!readValue(in, magic) || magic != checkpointMagic)
+        return false;
+    if (!readValue(in, version) || version != checkpointVersion)
+        return false;
+
+    checkpoint loaded;
+    if (!readValue(in, loaded.image_width) || !readValue(in, loaded.image_height) ||
+        !readValue(in, loaded.samples_per_pixel) || !readValue(in, loaded.images) ||
+        !readValue(in, loaded.threads) || !readValue(in, loaded.scene_hash) || !readValue(in, loaded.frame) ||
+        !readValue(in, loaded.samples) || !readValue(in, loaded.x))
+        return false;
+    if (loaded.image_width <= 0 || loaded.image_height <= 0 || loaded.threads <= 0)
+        return false;
+
+    loaded.accum.resize((size_t)loaded.image_width * loaded.image_height * 3);
+    loaded.rng_states.resize(loaded.threads);
+
+    if (!in.read((char *)loaded.accum.data(), loaded.accum.size() * sizeof(float)))
+        return false;
+    if (!in.read((char *)loaded.rng_states.data(), loaded.rng_states.size() * sizeof(uint64_t)))
+        return false;
+
+    cp = loaded;
+    return true;
+}
+
+#endif
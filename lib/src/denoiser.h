@@ -0,0 +1,140 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "rtweekend.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+/// first-hit surface data, averaged over a few rays per pixel
+struct aov_buffers
+{
+    std::vector<float> albedo; // 3 per pixel
+    std::vector<float> normal; // 3 per pixel, zero where the ray escaped
+    std::vector<float> depth;  // 1 per pixel, distance to the first hit
+
+    void resize(int width, int height)
+    {
+        albedo.assign((size_t)width * height * 3, 0.0f);
+        normal.assign((size_t)width * height * 3, 0.0f);
+        depth.assign((size_t)width * height, 0.0f);
+    }
+};
+
+/// one à-trous iteration over rows [row0, row1): a 5x5 B3-spline kernel with holes of size step,
+/// each tap weighted down when its color, normal, albedo or depth differs from the center
+inline void atrous_rows(const float *in, float *out, const aov_buffers &aov, int width, int height, int step, float sigma_color, int row0, int row1)
+{
+    static const float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+
+    for (int y = row0; y < row1; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int p = y * width + x;
+            const float *cp = &in[p * 3];
+            const float *np = &aov.normal[p * 3];
+            const float *ap = &aov.albedo[p * 3];
+            float zp = aov.depth[p];
+            bool p_escaped = np[0] == 0 && np[1] == 0 && np[2] == 0;
+
+            float sum[3] = {0, 0, 0};
+            float weight_sum = 0;
+
+            for (int dy = -2; dy <= 2; dy++)
+            {
+                int qy = y + dy * step;
+                if (qy < 0 || qy >= height)
+                    continue;
+
+                for (int dx = -2; dx <= 2; dx++)
+                {
+                    int qx = x + dx * step;
+                    if (qx < 0 || qx >= width)
+                        continue;
+
+                    int q = qy * width + qx;
+                    const float *cq = &in[q * 3];
+                    const float *nq = &aov.normal[q * 3];
+                    const float *aq = &aov.albedo[q * 3];
+                    bool q_escaped = nq[0] == 0 && nq[1] == 0 && nq[2] == 0;
+
+                    if (p_escaped != q_escaped)
+                        continue;
+
+                    float dc = 0, da = 0;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        dc += (cp[c] - cq[c]) * (cp[c] - cq[c]);
+                        da += (ap[c] - aq[c]) * (ap[c] - aq[c]);
+                    }
+
+                    float w = kernel[dx + 2] * kernel[dy + 2];
+                    w *= std::exp(-dc / (sigma_color * sigma_color) - da / 0.01f);
+
+                    if (!p_escaped)
+                    {
+                        float cosine = np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2];
+                        w *= cosine > 0 ? std::pow(cosine, 64.0f) : 0.0f;
+                        w *= std::exp(-std::fabs(zp - aov.depth[q]) / (0.02f * zp * step + 1e-4f));
+                    }
+
+                    for (int c = 0; c < 3; c++)
+                        sum[c] += w * cq[c];
+                    weight_sum += w;
+                }
+            }
+
+            for (int c = 0; c < 3; c++)
+                out[p * 3 + c] = weight_sum > 0 ? sum[c] / weight_sum : cp[c];
+        }
+    }
+}
+
+/// Edge-aware à-trous wavelet filter. accum holds color sums over samples_per_pixel samples;
+/// out receives the filtered mean color. Lighting is separated from albedo before filtering,
+/// so surface color detail stays sharp, and each pass is split into row bands across threads.
+void denoise(const float *accum, int samples_per_pixel, const aov_buffers &aov, int width, int height, int threads, std::vector<float> &out)
+{
+    const int iterations = 4;
+    size_t count = (size_t)width * height * 3;
+    std::vector<float> work(count);
+    out.resize(count);
+
+    for (size_t k = 0; k < count; k++)
+    {
+        work[k] = accum[k] / samples_per_pixel / std::fmax(aov.albedo[k], 0.01f);
+    }
+
+    if (threads < 1)
+        threads = 1;
+    std::vector<std::thread> workers;
+    float sigma_color = 0.5f;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        int step = 1 << i;
+        for (int t = 0; t < threads; t++)
+        {
+            int row0 = height * t / threads;
+            int row1 = height * (t + 1) / threads;
+            workers.push_back(std::thread(atrous_rows, work.data(), out.data(), std::cref(aov), width, height, step, sigma_color, row0, row1));
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        workers.clear();
+
+        work.swap(out);
+        sigma_color *= 0.5f;
+    }
+
+    for (size_t k = 0; k < count; k++)
+    {
+        out[k] = work[k] * std::fmax(aov.albedo[k], 0.01f);
+    }
+}
+
+#endif
@@ -2,17 +2,35 @@
 #define HITTABLE_H
 
 #include "rtweekend.h"
+#include "aabb.h"
 
 class material;
+class hittable;
+
+// How many instances inside instances a closest hit can pass through before they shade on the spot.
+const int max_instance_depth = 4;
 
 struct hit_record
 {
     point3 p;
     vec3 normal;
-    shared_ptr<material> mat_ptr;
+    const material *mat_ptr = nullptr; // owned by the object hit, so filling a record counts no references
     double t;
     bool front_face;
 
+    // Set by intersect(): what still has to fill in p, normal and mat_ptr (nullptr once done),
+    // and which of its primitives was hit.
+    const hittable *object = nullptr;
+    int primitive = 0;
+
+    // Set by an instance's intersect(): the object and primitive it hit inside. An instance's own
+    // primitive is -(slot + 1), so the slots in use always follow the current hit.
+    struct
+    {
+        const hittable *object;
+        int primitive;
+    } inner[max_instance_depth];
+
     inline void set_face_normal(const ray &r, const vec3 &outward_normal)
     {
         front_face = dot(r.direction(), outward_normal) < 0;
@@ -23,7 +41,32 @@ struct hit_record
 class hittable
 {
 public:
-    virtual bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const = 0;
+    // Closest hit with the full record.
+    bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const
+    {
+        if (!intersect(r, t_min, t_max, rec))
+            return false;
+
+        if (rec.object)
+        {
+            rec.object->shade(r, rec);
+            rec.object = nullptr;
+        }
+
+        return true;
+    }
+
+    // Closest hit during traversal: only rec.t, rec.object and rec.primitive are written,
+    // and rec is left untouched on a miss.
+    virtual bool intersect(const ray &r, double t_min, double t_max, hit_record &rec) const = 0;
+
+    // Fills in the rest of a record that intersect() found on this object.
+    virtual void shade(const ray &r, hit_record &rec) const {}
+
+    // True as soon as anything is hit in [t_min, t_max]; no hit record is built.
+    virtual bool occluded(const ray &r, double t_min, double t_max) const = 0;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const = 0;
 };
 
 #endif
@@ -18,30 +18,64 @@ public:
     void clear() { objects.clear(); }
     void add(shared_ptr<hittable> object) { objects.push_back(object); }
 
-    virtual bool hit(
+    virtual bool intersect(
         const ray &r, double t_min, double t_max, hit_record &rec) const override;
 
+    virtual bool occluded(
+        const ray &r, double t_min, double t_max) const override;
+
+    virtual bool bounding_box(
+        double time0, double time1, aabb &output_box) const override;
+
 public:
     std::vector<shared_ptr<hittable>> objects;
 };
 
-bool hittable_list::hit(const ray &r, double t_min, double t_max, hit_record &rec) const
+bool hittable_list::intersect(const ray &r, double t_min, double t_max, hit_record &rec) const
 {
-    hit_record temp_rec;
     bool hit_anything = false;
     auto closest_so_far = t_max;
 
     for (const auto &object : objects)
     {
-        if (object->hit(r, t_min, closest_so_far, temp_rec))
+        if (object->intersect(r, t_min, closest_so_far, rec))
         {
             hit_anything = true;
-            closest_so_far = temp_rec.t;
-            rec = temp_rec;
+            closest_so_far = rec.t;
         }
     }
 
     return hit_anything;
 }
 
+bool hittable_list::occluded(const ray &r, double t_min, double t_max) const
+{
+    for (const auto &object : objects)
+    {
+        if (object->occluded(r, t_min, t_max))
+            return true;
+    }
+
+    return false;
+}
+
+bool hittable_list::bounding_box(double time0, double time1, aabb &output_box) const
+{
+    if (objects.empty())
+        return false;
+
+    aabb temp_box;
+    bool first_box = true;
+
+    for (const auto &object : objects)
+    {
+        if (!object->bounding_box(time0, time1, temp_box))
+            return false;
+        output_box = first_box ? temp_box : surrounding_box(output_box, temp_box);
+        first_box = false;
+    }
+
+    return true;
+}
+
 #endif
@@ -0,0 +1,236 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+
+/// Transforms refer to a shared object (usually a prebuilt bvh_node) instead of copying it,
+/// so a cluster built once can be placed any number of times under a top-level bvh_node.
+/// Their intersect() only remembers what was hit inside; shade() brings the ray back into
+/// object space, shades the inner hit there and transforms the result out again.
+
+/// record the inner hit in the next free slot and make the instance the object hit; false when
+/// the instances are nested too deep, and the inner hit has to be shaded right away
+inline bool push_instance(const hittable *instance, hit_record &rec)
+{
+    int slot = rec.primitive < 0 ? -rec.primitive : 0;
+    if (!rec.object || slot == max_instance_depth)
+        return false;
+
+    rec.inner[slot].object = rec.object;
+    rec.inner[slot].primitive = rec.primitive;
+    rec.object = instance;
+    rec.primitive = -(slot + 1);
+    return true;
+}
+
+/// undo push_instance: the inner object, or nullptr for an inner hit that is already shaded
+inline const hittable *pop_instance(hit_record &rec)
+{
+    if (!rec.object)
+        return nullptr;
+
+    int slot = -rec.primitive - 1;
+    rec.object = rec.inner[slot].object;
+    rec.primitive = rec.inner[slot].primitive;
+    return rec.object;
+}
+
+class translate : public hittable
+{
+public:
+    translate(shared_ptr<hittable> p, const vec3 &displacement)
+        : ptr(p), offset(displacement) {}
+
+    virtual bool intersect(
+        const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+    virtual void shade(const ray &r, hit_record &rec) const override;
+
+    virtual bool occluded(const ray &r, double t_min, double t_max) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
+public:
+    shared_ptr<hittable> ptr;
+    vec3 offset;
+};
+
+bool translate::intersect(const ray &r, double t_min, double t_max, hit_record &rec) const
+{
+    ray moved_r(r.origin() - offset, r.direction(), r.time());
+    if (!ptr->intersect(moved_r, t_min, t_max, rec))
+        return false;
+
+    if (!push_instance(this, rec))
+    {
+        if (rec.object)
+            rec.object->shade(moved_r, rec);
+        rec.object = nullptr;
+        rec.p += offset;
+    }
+
+    return true;
+}
+
+void translate::shade(const ray &r, hit_record &rec) const
+{
+    ray moved_r(r.origin() - offset, r.direction(), r.time());
+    if (auto inner = pop_instance(rec))
+        inner->shade(moved_r, rec);
+
+    rec.p += offset;
+}
+
+bool translate::occluded(const ray &r, double t_min, double t_max) const
+{
+    return ptr->occluded(ray(r.origin() - offset, r.direction(), r.time()), t_min, t_max);
+}
+
+bool translate::bounding_box(double time0, double time1, aabb &output_box) const
+{
+    if (!ptr->bounding_box(time0, time1, output_box))
+        return false;
+
+    output_box = aabb(
+        output_box.min() + offset,
+        output_box.max() + offset);
+
+    return true;
+}
+
+class rotate_y : public hittable
+{
+public:
+    rotate_y(shared_ptr<hittable> p, double angle);
+
+    virtual bool intersect(
+        const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+    virtual void shade(const ray &r, hit_record &rec) const override;
+
+    virtual bool occluded(const ray &r, double t_min, double t_max) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override
+    {
+        output_box = bbox;
+        return hasbox;
+    }
+
+private:
+    ray to_object(const ray &r) const;
+    void to_world(hit_record &rec) const;
+
+public:
+    shared_ptr<hittable> ptr;
+    double sin_theta;
+    double cos_theta;
+    bool hasbox;
+    aabb bbox;
+};
+
+rotate_y::rotate_y(shared_ptr<hittable> p, double angle) : ptr(p)
+{
+    auto radians = degrees_to_radians(angle);
+    sin_theta = sin(radians);
+    cos_theta = cos(radians);
+    hasbox = ptr->bounding_box(0, 1, bbox);
+
+    point3 min(infinity, infinity, infinity);
+    point3 max(-infinity, -infinity, -infinity);
+
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                auto x = i * bbox.max().x() + (1 - i) * bbox.min().x();
+                auto y = j * bbox.max().y() + (1 - j) * bbox.min().y();
+                auto z = k * bbox.max().z() + (1 - k) * bbox.min().z();
+
+                auto newx = cos_theta * x + sin_theta * z;
+                auto newz = -sin_theta * x + cos_theta * z;
+
+                vec3 tester(newx, y, newz);
+
+                for (int c = 0; c < 3; c++)
+                {
+                    min[c] = fmin(min[c], tester[c]);
+                    max[c] = fmax(max[c], tester[c]);
+                }
+            }
+        }
+    }
+
+    bbox = aabb(min, max);
+}
+
+ray rotate_y::to_object(const ray &r) const
+{
+    auto origin = r.origin();
+    auto direction = r.direction();
+
+    origin[0] = cos_theta * r.origin()[0] - sin_theta * r.origin()[2];
+    origin[2] = sin_theta * r.origin()[0] + cos_theta * r.origin()[2];
+
+    direction[0] = cos_theta * r.direction()[0] - sin_theta * r.direction()[2];
+    direction[2] = sin_theta * r.direction()[0] + cos_theta * r.direction()[2];
+
+    return ray(origin, direction, r.time());
+}
+
+bool rotate_y::occluded(const ray &r, double t_min, double t_max) const
+{
+    return ptr->occluded(to_object(r), t_min, t_max);
+}
+
+bool rotate_y::intersect(const ray &r, double t_min, double t_max, hit_record &rec) const
+{
+    ray rotated_r = to_object(r);
+
+    if (!ptr->intersect(rotated_r, t_min, t_max, rec))
+        return false;
+
+    if (!push_instance(this, rec))
+    {
+        if (rec.object)
+            rec.object->shade(rotated_r, rec);
+        rec.object = nullptr;
+        to_world(rec);
+    }
+
+    return true;
+}
+
+void rotate_y::shade(const ray &r, hit_record &rec) const
+{
+    if (auto inner = pop_instance(rec))
+        inner->shade(to_object(r), rec);
+
+    to_world(rec);
+}
+
+void rotate_y::to_world(hit_record &rec) const
+{
+    auto p = rec.p;
+    auto normal = rec.normal;
+
+    p[0] = cos_theta * rec.p[0] + sin_theta * rec.p[2];
+    p[2] = -sin_theta * rec.p[0] + cos_theta * rec.p[2];
+
+    normal[0] = cos_theta * rec.normal[0] + sin_theta * rec.normal[2];
+    normal[2] = -sin_theta * rec.normal[0] + cos_theta * rec.normal[2];
+
+    rec.p = p;
+    rec.normal = normal;
+}
+
+/// place a shared object: rotate it about its own y axis, then move it into position
+inline shared_ptr<hittable> make_instance(shared_ptr<hittable> object, const vec3 &displacement, double angle)
+{
+    return make_shared<translate>(make_shared<rotate_y>(object, angle), displacement);
+}
+
+#endif
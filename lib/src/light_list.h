@@ -0,0 +1,103 @@
+#ifndef LIGHT_LIST_H
+#define LIGHT_LIST_H
+
+#include "rtweekend.h"
+
+#include "hittable_list.h"
+#include "material.h"
+#include "sphere.h"
+
+#include <vector>
+
+/// Spheres with an emissive material, sampled directly toward their visible cap
+/// so small lights are found without waiting for a random bounce to hit them.
+class light_list
+{
+public:
+    light_list() {}
+    light_list(const hittable_list &world)
+    {
+        for (const auto &object : world.objects)
+        {
+            auto s = std::dynamic_pointer_cast<sphere>(object);
+            if (s && std::dynamic_pointer_cast<diffuse_light>(s->mat_ptr))
+                lights.push_back(s);
+        }
+    }
+
+    bool empty() const { return lights.empty(); }
+
+    /// the index of a hit object in the list, -1 for emitters the list does not sample
+    int index_of(const hittable *object) const;
+
+    /// density of sample() picking light index and a direction from origin that hits it. Only the light
+    /// a direction hits first counts: a sample aimed at a light behind it finds that light occluded
+    double pdf(int index, const point3 &origin) const;
+
+    /// pick a light uniformly and a direction inside the cone it subtends
+    bool sample(const point3 &origin, vec3 &direction, int &index) const;
+
+public:
+    std::vector<shared_ptr<sphere>> lights;
+};
+
+int light_list::index_of(const hittable *object) const
+{
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        if (lights[i].get() == object)
+            return (int)i;
+    }
+    return -1;
+}
+
+double light_list::pdf(int index, const point3 &origin) const
+{
+    if (index < 0)
+        return 0;
+
+    const auto &light = lights[index];
+    auto distance_squared = (light->center - origin).length_squared();
+    auto radius_squared = light->radius * light->radius;
+    if (distance_squared <= radius_squared)
+        return 0;
+
+    auto cos_theta_max = sqrt(1 - radius_squared / distance_squared);
+    return 1 / (2 * pi * (1 - cos_theta_max)) / lights.size();
+}
+
+bool light_list::sample(const point3 &origin, vec3 &direction, int &index) const
+{
+    index = (int)(random_double() * lights.size());
+    const auto &light = lights[index];
+
+    auto to_center = light->center - origin;
+    auto distance_squared = to_center.length_squared();
+    auto radius_squared = light->radius * light->radius;
+    if (distance_squared <= radius_squared)
+        return false;
+
+    // Uniform direction in the cone, built around w = direction to the center.
+    auto cos_theta_max = sqrt(1 - radius_squared / distance_squared);
+    auto z = 1 + random_double() * (cos_theta_max - 1);
+    auto phi = 2 * pi * random_double();
+    auto sin_theta = sqrt(1 - z * z);
+
+    vec3 w = unit_vector(to_center);
+    vec3 a = fabs(w.x()) > 0.9 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+    vec3 v = unit_vector(cross(w, a));
+    vec3 u = cross(w, v);
+
+    direction = cos(phi) * sin_theta * u + sin(phi) * sin_theta * v + z * w;
+    return true;
+}
+
+/// weight for one of two sampling strategies that can produce the same path
+inline double power_heuristic(double pdf, double other_pdf)
+{
+    auto a = pdf * pdf;
+    auto b = other_pdf * other_pdf;
+    return a / (a + b);
+}
+
+#endif
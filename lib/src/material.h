@@ -10,6 +10,25 @@ class material
 public:
     virtual bool scatter(
         const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const = 0;
+
+    virtual color emitted(const hit_record &rec) const
+    {
+        return color(0, 0, 0);
+    }
+
+    // Surface color written to the albedo AOV for the denoiser.
+    virtual color aov_albedo() const
+    {
+        return color(1, 1, 1);
+    }
+
+    // Solid-angle density with which scatter() picks this direction. scatter() must sample in
+    // proportion to the BRDF times cosine, so attenuation * pdf is that product. 0 for
+    // mirror-like materials, which light sampling cannot help.
+    virtual double scattering_pdf(const ray &r_in, const hit_record &rec, const ray &scattered) const
+    {
+        return 0;
+    }
 };
 
 class lambertian : public material
@@ -31,6 +50,17 @@ public:
         return true;
     }
 
+    virtual double scattering_pdf(const ray &r_in, const hit_record &rec, const ray &scattered) const override
+    {
+        auto cosine = dot(rec.normal, unit_vector(scattered.direction()));
+        return cosine < 0 ? 0 : cosine / pi;
+    }
+
+    virtual color aov_albedo() const override
+    {
+        return albedo;
+    }
+
 public:
     color albedo;
 };
@@ -49,6 +79,11 @@ public:
         return (dot(scattered.direction(), rec.normal) > 0);
     }
 
+    virtual color aov_albedo() const override
+    {
+        return albedo;
+    }
+
 public:
     color albedo;
     double fuzz;
@@ -94,4 +129,24 @@ private:
     }
 };
 
+class diffuse_light : public material
+{
+public:
+    diffuse_light(color c) : emit(c) {}
+
+    virtual bool scatter(
+        const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const override
+    {
+        return false;
+    }
+
+    virtual color emitted(const hit_record &rec) const override
+    {
+        return emit;
+    }
+
+public:
+    color emit;
+};
+
 #endif
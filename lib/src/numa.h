@@ -0,0 +1,162 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/// The processors of each numa node the process may run on. Workers are placed compactly: worker i
+/// gets the i-th processor counting node by node, so the first node fills up before the second is used.
+/// On Windows a processor is numbered group * 64 + its bit in the group's mask.
+struct numa_topology
+{
+    std::vector<std::vector<int>> nodes;
+    std::vector<int> ids; // the system's number for each node, nodes can be missing or offline
+
+    int processors() const
+    {
+        int count = 0;
+        for (const auto &node : nodes)
+            count += (int)node.size();
+        return count;
+    }
+
+    void place(int worker, int &node, int &cpu) const
+    {
+        int k = worker % processors();
+        for (node = 0; k >= (int)nodes[node].size(); node++)
+            k -= (int)nodes[node].size();
+        cpu = nodes[node][k];
+    }
+};
+
+#ifndef _WIN32
+/// parse a sysfs cpu or node list such as "0-7,16-23"
+inline std::vector<int> parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (getline(ss, range, ','))
+    {
+        size_t dash = range.find('-');
+        int first = std::stoi(range);
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+#endif
+
+/// nodes and the processors of each the process may use; one node with every such processor when the
+/// system reports none
+inline numa_topology detectTopology()
+{
+    numa_topology topology;
+
+#ifdef _WIN32
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest))
+    {
+        for (ULONG node = 0; node <= highest; node++)
+        {
+            /// past 64 processors nodes live in different processor groups
+            GROUP_AFFINITY affinity = {};
+            std::vector<int> cpus;
+            if (GetNumaNodeProcessorMaskEx((USHORT)node, &affinity))
+            {
+                for (int bit = 0; bit < 64; bit++)
+                {
+                    if (affinity.Mask & ((KAFFINITY)1 << bit))
+                        cpus.push_back(affinity.Group * 64 + bit);
+                }
+            }
+            if (!cpus.empty())
+            {
+                topology.nodes.push_back(cpus);
+                topology.ids.push_back((int)node);
+            }
+        }
+    }
+
+    std::vector<int> allowed;
+#else
+    /// only the processors this process may use: taskset, cpusets and cgroups all show up in its affinity
+    std::vector<int> allowed;
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &affinity))
+                allowed.push_back(cpu);
+        }
+    }
+
+    /// node numbers can have gaps, so go by the list of online nodes
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodeList;
+    if (online && getline(online, nodeList) && !nodeList.empty())
+    {
+        for (int node : parseCpuList(nodeList))
+        {
+            std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string line;
+            if (!list || !getline(list, line) || line.empty())
+                continue;
+
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(line))
+            {
+                if (allowed.empty() || std::binary_search(allowed.begin(), allowed.end(), cpu))
+                    cpus.push_back(cpu);
+            }
+            if (!cpus.empty())
+            {
+                topology.nodes.push_back(cpus);
+                topology.ids.push_back(node);
+            }
+        }
+    }
+#endif
+
+    if (topology.nodes.empty())
+    {
+        topology.nodes.push_back(allowed);
+        topology.ids.push_back(0);
+        for (int cpu = 0; allowed.empty() && cpu < (int)std::max(1u, std::thread::hardware_concurrency()); cpu++)
+            topology.nodes[0].push_back(cpu);
+    }
+
+    return topology;
+}
+
+/// keep the calling thread on one processor
+inline bool pinThread(int cpu)
+{
+#ifdef _WIN32
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = (WORD)(cpu / 64);
+    affinity.Mask = (KAFFINITY)1 << (cpu % 64);
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// what one thread parsed out of its share of the file
+struct obj_chunk
+{
+    std::vector<point3> vertices;
+    std::vector<int> indices;  // OBJ indices: positive are 1-based global, negative are relative
+    std::vector<int> vertices_before; // vertices parsed in this chunk before each index, for relative ones
+};
+
+inline const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    return p;
+}
+
+inline void parse_obj_chunk(const char *begin, const char *end, obj_chunk *chunk)
+{
+    const char *p = begin;
+    std::vector<int> face;
+
+    while (p < end)
+    {
+        const char *line_end = p;
+        while (line_end < end && *line_end != '\n')
+            ++line_end;
+
+        p = skip_spaces(p, line_end);
+
+        if (line_end - p > 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            char *next;
+            double x = strtod(p + 2, &next);
+            double y = strtod(next, &next);
+            double z = strtod(next, &next);
+            chunk->vertices.push_back(point3(x, y, z));
+        }
+        else if (line_end - p > 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            face.clear();
+            const char *q = p + 2;
+            while (true)
+            {
+                q = skip_spaces(q, line_end);
+                if (q >= line_end || *q == '\r')
+                    break;
+
+                // Only the position index matters; skip any "/vt/vn" part.
+                char *next;
+                long v = strtol(q, &next, 10);
+                if (next == q)
+                    break;
+                face.push_back((int)v);
+
+                q = next;
+                while (q < line_end && *q != ' ' && *q != '\t')
+                    ++q;
+            }
+
+            // Triangulate polygons as a fan around the first corner.
+            for (size_t k = 2; k < face.size(); k++)
+            {
+                int corners[3] = {face[0], face[k - 1], face[k]};
+                for (int c : corners)
+                {
+                    chunk->indices.push_back(c);
+                    chunk->vertices_before.push_back((int)chunk->vertices.size());
+                }
+            }
+        }
+
+        p = line_end + 1;
+    }
+}
+
+/// Reads the vertex positions and faces of an OBJ file. The file is split at line breaks into
+/// one piece per thread, the pieces are parsed in parallel and then stitched together.
+bool load_obj(const std::string &fileName, std::vector<point3> &vertices, std::vector<int> &indices, int threads = 0)
+{
+    std::ifstream infile(fileName, std::ios::binary | std::ios::ate);
+    if (!infile)
+        return false;
+
+    std::string data((size_t)infile.tellg(), '\0');
+    infile.seekg(0);
+    infile.read(&data[0], data.size());
+
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    /// cut the buffer into line-aligned pieces
+    std::vector<const char *> cuts(1, data.data());
+    const char *end = data.data() + data.size();
+    for (int i = 1; i < threads; i++)
+    {
+        const char *cut = data.data() + data.size() * i / threads;
+        if (cut < cuts.back())
+            cut = cuts.back();
+        while (cut < end && *cut != '\n')
+            ++cut;
+        cuts.push_back(cut < end ? cut + 1 : end);
+    }
+    cuts.push_back(end);
+
+    std::vector<obj_chunk> chunks(cuts.size() - 1);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < cuts.size(); i++)
+    {
+        workers.push_back(std::thread(parse_obj_chunk, cuts[i], cuts[i + 1], &chunks[i]));
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    /// stitch the pieces together, resolving relative indices against the global vertex count
+    size_t vertex_total = 0, index_total = 0;
+    for (const auto &chunk : chunks)
+    {
+        vertex_total += chunk.vertices.size();
+        index_total += chunk.indices.size();
+    }
+
+    vertices.clear();
+    indices.clear();
+    vertices.reserve(vertex_total);
+    indices.reserve(index_total);
+
+    for (const auto &chunk : chunks)
+    {
+        int offset = (int)vertices.size();
+        vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+
+        for (size_t k = 0; k < chunk.indices.size(); k++)
+        {
+            int v = chunk.indices[k];
+            indices.push_back(v > 0 ? v - 1 : offset + chunk.vertices_before[k] + v);
+        }
+    }
+
+    for (int v : indices)
+    {
+        if (v < 0 || v >= (int)vertices.size())
+            return false;
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef PREVIEW_SERVER_H
+#define PREVIEW_SERVER_H
+
+#include "rtweekend.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET socket_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+/// Minimal HTTP server on localhost for the interactive preview. The page polls /frame.bmp
+/// for the newest image and sends /camera?x=..&y=..&z=.. when the view moves; every camera
+/// change bumps generation, which the renderer checks to drop work on the old view.
+class preview_server
+{
+public:
+    preview_server(int port, point3 lookfrom) : port(port), generation(0), from(lookfrom) {}
+
+    ~preview_server()
+    {
+        running = false;
+        if (listener != INVALID_SOCKET)
+            closesocket(listener);
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool start();
+
+    /// replace the image served at /frame.bmp
+    void publish(const std::string &bmp)
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        frame = bmp;
+    }
+
+    point3 lookfrom()
+    {
+        std::lock_guard<std::mutex> lock(cameraMutex);
+        return from;
+    }
+
+public:
+    int port;
+    std::atomic<int> generation;
+
+private:
+    void serve();
+    void respond(socket_t client);
+    void send_all(socket_t client, const std::string &data);
+    static void set_timeout(socket_t client, int milliseconds);
+    std::string page();
+
+    socket_t listener = INVALID_SOCKET;
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    std::mutex frameMutex;
+    std::string frame;
+
+    std::mutex cameraMutex;
+    point3 from;
+};
+
+bool preview_server::start()
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        return false;
+#endif
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET)
+        return false;
+
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof(yes));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+
+    if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 8) != 0)
+    {
+        closesocket(listener);
+        listener = INVALID_SOCKET;
+        return false;
+    }
+
+    running = true;
+    worker = std::thread(&preview_server::serve, this);
+    return true;
+}
+
+void preview_server::serve()
+{
+    while (running)
+    {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET)
+            continue;
+
+        /// one client at a time, so one that connects and sends nothing must not hold the rest up
+        set_timeout(client, 1000);
+        respond(client);
+        closesocket(client);
+    }
+}
+
+void preview_server::set_timeout(socket_t client, int milliseconds)
+{
+#ifdef _WIN32
+    DWORD timeout = milliseconds;
+#else
+    timeval timeout;
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_usec = (milliseconds % 1000) * 1000;
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+}
+
+void preview_server::send_all(socket_t client, const std::string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        int n = send(client, data.data() + sent, (int)(data.size() - sent), 0);
+        if (n <= 0)
+            return;
+        sent += n;
+    }
+}
+
+void preview_server::respond(socket_t client)
+{
+    /// only the request line matters
+    char request[2048];
+    int n = recv(client, request, sizeof(request) - 1, 0);
+    if (n <= 0)
+        return;
+    request[n] = 0;
+
+    std::string line(request, strcspn(request, "\r\n"));
+    std::string path;
+    std::istringstream(line.substr(line.find(' ') + 1)) >> path;
+
+    std::string type = "text/html";
+    std::string body;
+
+    if (path.compare(0, 10, "/frame.bmp") == 0)
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        type = "image/bmp";
+        body = frame;
+    }
+    else if (path.compare(0, 8, "/camera?") == 0)
+    {
+        point3 p = lookfrom();
+        std::istringstream query(path.substr(8));
+        std::string pair;
+        while (std::getline(query, pair, '&'))
+        {
+            if (pair.size() > 2 && pair[1] == '=' && pair[0] >= 'x' && pair[0] <= 'z')
+                p[pair[0] - 'x'] = atof(pair.c_str() + 2);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(cameraMutex);
+            from = p;
+        }
+        ++generation;
+        type = "text/plain";
+        body = "ok";
+    }
+    else
+    {
+        body = page();
+    }
+
+    std::ostringstream header;
+    header << "HTTP/1.1 200 OK\r\nContent-Type: " << type
+           << "\r\nContent-Length: " << body.size()
+           << "\r\nCache-Control: no-store\r\nConnection: close\r\n\r\n";
+    send_all(client, header.str());
+    send_all(client, body);
+}
+
+std::string preview_server::page()
+{
+    point3 p = lookfrom();
+    std::ostringstream html;
+    html << "<!doctype html><html><body style='margin:0;background:#111;color:#ccc;font:12px sans-serif'>"
+         << "<img id='f' style='width:100%;image-rendering:pixelated'>"
+         << "<p>W/S: forward/back, A/D: left/right, Q/E: up/down</p><script>"
+         << "let c=[" << p.x() << "," << p.y() << "," << p.z() << "];"
+         << "const f=document.getElementById('f');"
+         << "function next(){f.src='/frame.bmp?'+Date.now();}"
+         << "f.onload=f.onerror=()=>setTimeout(next,15);next();"
+         << "const keys={a:[0,-1],d:[0,1],q:[1,1],e:[1,-1],w:[2,-1],s:[2,1]};"
+         << "document.onkeydown=e=>{const k=keys[e.key];if(!k)return;c[k[0]]+=0.25*k[1];"
+         << "fetch('/camera?x='+c[0]+'&y='+c[1]+'&z='+c[2]);};"
+         << "</script></body></html>";
+    return html.str();
+}
+
+#endif
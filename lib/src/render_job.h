@@ -0,0 +1,50 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include "rtweekend.h"
+
+#include "camera.h"
+
+#include <string>
+
+/// What every image of a camera sweep shares: the frame size and sampling, the sweep itself and where
+/// the images go. Image c is seen from x - c * moveSize, looking at the origin.
+struct render_job
+{
+    int image_height = 0;
+    int image_width = 0;
+    int samples_per_pixel = 0;
+    int max_depth = 0;
+    int images = 0;
+    int threads = 1;
+
+    double x = 0, y = 0, z = 0;
+    double moveSize = 0;
+    double aspect_ratio = 1;
+    double aperture = 0;
+    double dist_to_focus = 1;
+    double shutterClose = 0; // zero when nothing moves, so cameras skip the time sample
+
+    bool denoiseImage = false;
+    std::string imgPreffix;
+    std::string imgSuffix;
+
+    /// the sweep's camera placed at lookfrom
+    camera cameraAt(const point3 &lookfrom) const
+    {
+        return camera(lookfrom, point3(0, 0, 0), vec3(0, 1, 0), 90, aspect_ratio, aperture, dist_to_focus, 0.0, shutterClose);
+    }
+
+    /// the camera of image c
+    camera sweepCamera(int c) const
+    {
+        return cameraAt(point3(x - c * moveSize, y, z));
+    }
+
+    std::string fileName(int c) const
+    {
+        return imgPreffix + std::to_string(c) + imgSuffix;
+    }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define RTWEEKEND_H
 
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <cstdlib>
@@ -21,10 +22,35 @@ inline double degrees_to_radians(double degrees)
     return degrees * pi / 180.0;
 }
 
+inline uint64_t &random_state()
+{
+    // Each thread owns its own stream, so workers never share rand()'s state.
+    thread_local uint64_t state = 0x853c49e6748fea9bULL;
+    return state;
+}
+
+inline uint64_t seeded_state(uint64_t seed)
+{
+    // Scramble the seed (splitmix64) so neighbouring seeds give unrelated streams.
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31)) | 1;
+}
+
+inline void seed_random(uint64_t seed)
+{
+    random_state() = seeded_state(seed);
+}
+
 inline double random_double()
 {
-    // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    // Returns a random real in [0,1) from the calling thread's xorshift64* stream.
+    uint64_t &s = random_state();
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return ((s * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
 }
 
 inline double random_double(double min, double max)
@@ -0,0 +1,107 @@
+#ifndef SAH_H
+#define SAH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+
+#include <algorithm>
+#include <vector>
+
+/// Binned surface area heuristic shared by the scene and mesh bvh builds: sort centroids into
+/// bins along the widest axis, cut where area(left) * count(left) + area(right) * count(right)
+/// is smallest, and partition items[start, end) there. Returns the first index of the right side.
+template <typename Item, typename BoxOf, typename CentroidOf>
+size_t sah_split(std::vector<Item> &items, size_t start, size_t end, BoxOf box_of, CentroidOf centroid_of)
+{
+    const int bin_count = 16;
+    size_t mid = start + (end - start) / 2;
+
+    point3 lo = centroid_of(items[start]);
+    point3 hi = lo;
+    for (size_t i = start; i < end; i++)
+    {
+        point3 c = centroid_of(items[i]);
+        for (int a = 0; a < 3; a++)
+        {
+            lo[a] = fmin(lo[a], c[a]);
+            hi[a] = fmax(hi[a], c[a]);
+        }
+    }
+
+    auto extent = hi - lo;
+    int axis = extent.x() > extent.y() ? (extent.x() > extent.z() ? 0 : 2) : (extent.y() > extent.z() ? 1 : 2);
+
+    auto median_split = [&]()
+    {
+        std::nth_element(
+            items.begin() + start, items.begin() + mid, items.begin() + end,
+            [&](const Item &a, const Item &b)
+            { return centroid_of(a)[axis] < centroid_of(b)[axis]; });
+        return mid;
+    };
+
+    if (extent[axis] <= 0)
+        return median_split();
+
+    auto bin_of = [&](const Item &item)
+    {
+        int b = (int)(bin_count * (centroid_of(item)[axis] - lo[axis]) / extent[axis]);
+        return b < bin_count ? b : bin_count - 1;
+    };
+
+    size_t counts[bin_count] = {};
+    aabb boxes[bin_count];
+    for (size_t i = start; i < end; i++)
+    {
+        int b = bin_of(items[i]);
+        boxes[b] = counts[b] == 0 ? box_of(items[i]) : surrounding_box(boxes[b], box_of(items[i]));
+        counts[b]++;
+    }
+
+    /// sweep from the right to get the cost of every right-hand side
+    double right_area[bin_count];
+    size_t right_count[bin_count];
+    aabb sweep;
+    size_t n = 0;
+    for (int b = bin_count - 1; b > 0; b--)
+    {
+        if (counts[b] > 0)
+            sweep = n == 0 ? boxes[b] : surrounding_box(sweep, boxes[b]);
+        n += counts[b];
+        right_area[b] = n > 0 ? sweep.area() : 0;
+        right_count[b] = n;
+    }
+
+    int best_bin = -1;
+    double best_cost = infinity;
+    n = 0;
+    for (int b = 0; b < bin_count - 1; b++)
+    {
+        if (counts[b] > 0)
+            sweep = n == 0 ? boxes[b] : surrounding_box(sweep, boxes[b]);
+        n += counts[b];
+
+        if (n == 0 || right_count[b + 1] == 0)
+            continue;
+
+        double cost = sweep.area() * n + right_area[b + 1] * right_count[b + 1];
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best_bin = b;
+        }
+    }
+
+    if (best_bin < 0)
+        return median_split();
+
+    auto cut = std::partition(
+        items.begin() + start, items.begin() + end,
+        [&](const Item &item)
+        { return bin_of(item) <= best_bin; });
+
+    return cut - items.begin();
+}
+
+#endif
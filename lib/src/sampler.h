@@ -0,0 +1,57 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rtweekend.h"
+
+#include <cmath>
+
+/// one camera sample: pixel offset, lens position and shutter time, all in [0,1)
+struct camera_sample
+{
+    double px, py;
+    double lens_s, lens_t;
+    double time;
+};
+
+/// Low-discrepancy samples for the five camera dimensions from the R-sequence (a Kronecker
+/// sequence built on the generalised golden ratio). Each pixel shifts it by its own hashed
+/// offset, so neighbouring pixels do not share a pattern. Sample k depends only on the
+/// pixel and k, so renders split into passes continue the same sequence.
+class pixel_sampler
+{
+public:
+    pixel_sampler(uint64_t pixel_seed)
+    {
+        uint64_t state = pixel_seed;
+        for (int d = 0; d < 5; d++)
+        {
+            state = seeded_state(state);
+            shift[d] = (state >> 11) * (1.0 / 9007199254740992.0);
+        }
+    }
+
+    camera_sample get(int k) const
+    {
+        double x[5];
+        for (int d = 0; d < 5; d++)
+        {
+            double value = shift[d] + alpha()[d] * (k + 1);
+            x[d] = value - (int64_t)value;
+        }
+        return camera_sample{x[0], x[1], x[2], x[3], x[4]};
+    }
+
+private:
+    static const double *alpha()
+    {
+        // 1 / g^(d+1), where g = 1.13472... is the root of x^6 = x + 1.
+        static const double a[5] = {
+            0.8812714616335696, 0.7766393890897682, 0.6844301295853426,
+            0.6031687406857283, 0.5315553977157913};
+        return a;
+    }
+
+    double shift[5];
+};
+
+#endif
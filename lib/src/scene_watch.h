@@ -0,0 +1,51 @@
+#ifndef SCENE_WATCH_H
+#define SCENE_WATCH_H
+
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "hittable.h"
+#include "material.h"
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/// What each line of a scene file produced when it was last read, so an edited file can be
+/// applied as a diff: unchanged lines keep their objects, and the materials keep their colors.
+struct scene_watch
+{
+    std::string fileName;
+    std::vector<std::string> lines;
+    std::vector<shared_ptr<hittable>> objects; // one per line, nullptr for comments
+    std::map<std::string, shared_ptr<material>> materials;
+    shared_ptr<bvh_node> bvh;
+
+    std::chrono::steady_clock::time_point lastPoll;
+
+    scene_watch(std::string fileName) : fileName(fileName) {}
+
+    /// at most every 100ms, read the file and report whether it differs from lines
+    bool poll(std::vector<std::string> &current)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastPoll < std::chrono::milliseconds(100))
+            return false;
+        lastPoll = now;
+
+        std::ifstream infile(fileName);
+        if (!infile)
+            return false;
+
+        current.clear();
+        std::string line;
+        while (getline(infile, line))
+            current.push_back(line);
+
+        return current != lines;
+    }
+};
+
+#endif
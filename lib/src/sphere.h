@@ -11,16 +11,22 @@ public:
     sphere(point3 cen, double r, shared_ptr<material> m)
         : center(cen), radius(r), mat_ptr(m){};
 
-    virtual bool hit(
+    virtual bool intersect(
         const ray &r, double t_min, double t_max, hit_record &rec) const override;
 
+    virtual void shade(const ray &r, hit_record &rec) const override;
+
+    virtual bool occluded(const ray &r, double t_min, double t_max) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
 public:
     point3 center;
     double radius;
     shared_ptr<material> mat_ptr;
 };
 
-bool sphere::hit(const ray &r, double t_min, double t_max, hit_record &rec) const
+bool sphere::intersect(const ray &r, double t_min, double t_max, hit_record &rec) const
 {
     vec3 oc = r.origin() - center;
     auto a = r.direction().length_squared();
@@ -42,11 +48,44 @@ bool sphere::hit(const ray &r, double t_min, double t_max, hit_record &rec) cons
     }
 
     rec.t = root;
+    rec.object = this;
+    rec.primitive = 0;
+
+    return true;
+}
+
+void sphere::shade(const ray &r, hit_record &rec) const
+{
     rec.p = r.at(rec.t);
     vec3 outward_normal = (rec.p - center) / radius;
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_ptr = mat_ptr.get();
+}
+
+bool sphere::occluded(const ray &r, double t_min, double t_max) const
+{
+    vec3 oc = r.origin() - center;
+    auto a = r.direction().length_squared();
+    auto half_b = dot(oc, r.direction());
+    auto c = oc.length_squared() - radius * radius;
+
+    auto discriminant = half_b * half_b - a * c;
+    if (discriminant < 0)
+        return false;
+    auto sqrtd = sqrt(discriminant);
+
+    auto root = (-half_b - sqrtd) / a;
+    if (root >= t_min && root <= t_max)
+        return true;
+    root = (-half_b + sqrtd) / a;
+    return root >= t_min && root <= t_max;
+}
 
+bool sphere::bounding_box(double time0, double time1, aabb &output_box) const
+{
+    output_box = aabb(
+        center - vec3(radius, radius, radius),
+        center + vec3(radius, radius, radius));
     return true;
 }
 
@@ -0,0 +1,378 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "sah.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/// up to four triangles stored lane by lane, so one intersection loop tests them all
+struct triangle_packet
+{
+    double v0[3][4];
+    double e1[3][4];
+    double e2[3][4];
+    int id[4]; // triangle index, -1 for an empty lane
+};
+
+struct mesh_node
+{
+    aabb box;
+    int next;  // inner node: index of the second child (the first follows directly); leaf: packet index
+    int count; // 0 for inner nodes, number of triangles in the leaf packet otherwise
+};
+
+/// Möller–Trumbore on four triangles at once; lanes that miss keep t at infinity.
+/// The loop has no branches, so compilers turn it into SIMD code.
+inline int intersect_packet(const triangle_packet &pk, const ray &r, double t_min, double t_max, double &t_hit)
+{
+    const double eps = 1e-12;
+    double t[4];
+    const vec3 o = r.origin();
+    const vec3 d = r.direction();
+
+    for (int k = 0; k < 4; k++)
+    {
+        // p = d x e2
+        double px = d[1] * pk.e2[2][k] - d[2] * pk.e2[1][k];
+        double py = d[2] * pk.e2[0][k] - d[0] * pk.e2[2][k];
+        double pz = d[0] * pk.e2[1][k] - d[1] * pk.e2[0][k];
+        double det = pk.e1[0][k] * px + pk.e1[1][k] * py + pk.e1[2][k] * pz;
+        double inv_det = 1.0 / det;
+
+        double sx = o[0] - pk.v0[0][k];
+        double sy = o[1] - pk.v0[1][k];
+        double sz = o[2] - pk.v0[2][k];
+        double u = (sx * px + sy * py + sz * pz) * inv_det;
+
+        // q = s x e1
+        double qx = sy * pk.e1[2][k] - sz * pk.e1[1][k];
+        double qy = sz * pk.e1[0][k] - sx * pk.e1[2][k];
+        double qz = sx * pk.e1[1][k] - sy * pk.e1[0][k];
+        double v = (d[0] * qx + d[1] * qy + d[2] * qz) * inv_det;
+        double tk = (pk.e2[0][k] * qx + pk.e2[1][k] * qy + pk.e2[2][k] * qz) * inv_det;
+
+        bool ok = fabs(det) > eps && u >= 0 && v >= 0 && u + v <= 1 && tk >= t_min && tk <= t_max;
+        t[k] = ok ? tk : infinity;
+    }
+
+    int best = -1;
+    for (int k = 0; k < 4; k++)
+    {
+        if (t[k] < t_max)
+        {
+            t_max = t[k];
+            best = k;
+        }
+    }
+
+    if (best >= 0)
+        t_hit = t_max;
+    return best;
+}
+
+/// part of a mesh bvh in depth-first order, so subtrees built on different threads can be spliced
+struct mesh_bvh_part
+{
+    std::vector<mesh_node> nodes;
+    std::vector<triangle_packet> packets;
+};
+
+/// Indexed triangle mesh: vertices are shared between triangles, and the mesh carries its own
+/// bvh over packets of four triangles, so it can sit as one object in the scene bvh.
+class triangle_mesh : public hittable
+{
+public:
+    triangle_mesh() {}
+    triangle_mesh(std::vector<point3> verts, std::vector<int> idx, shared_ptr<material> m, int threads = 0)
+        : vertices(std::move(verts)), indices(std::move(idx)), mat_ptr(m)
+    {
+        if (threads <= 0)
+            threads = std::max(1, (int)std::thread::hardware_concurrency());
+        build(threads);
+    }
+
+    virtual bool intersect(
+        const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+    virtual void shade(const ray &r, hit_record &rec) const override;
+
+    virtual bool occluded(const ray &r, double t_min, double t_max) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
+    size_t triangle_count() const { return indices.size() / 3; }
+
+    /// after vertices moved: recompute the packets and every box bottom-up, keeping the tree shape
+    void refit();
+
+private:
+    void build(int threads);
+    void build_node(mesh_bvh_part &part, std::vector<int> &tris, const std::vector<aabb> &boxes, const std::vector<point3> &centroids, int start, int end, int spare_threads) const;
+    void fill_packet(triangle_packet &pk, const int *tris, int count) const;
+
+public:
+    std::vector<point3> vertices;
+    std::vector<int> indices; // three vertex indices per triangle
+    shared_ptr<material> mat_ptr;
+
+    std::vector<mesh_node> nodes;
+    std::vector<triangle_packet> packets;
+};
+
+void triangle_mesh::build(int threads)
+{
+    int count = (int)triangle_count();
+    std::vector<int> tris(count);
+    std::vector<aabb> boxes(count);
+    std::vector<point3> centroids(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        const point3 &a = vertices[indices[3 * i]];
+        const point3 &b = vertices[indices[3 * i + 1]];
+        const point3 &c = vertices[indices[3 * i + 2]];
+
+        point3 lo(fmin(a.x(), fmin(b.x(), c.x())), fmin(a.y(), fmin(b.y(), c.y())), fmin(a.z(), fmin(b.z(), c.z())));
+        point3 hi(fmax(a.x(), fmax(b.x(), c.x())), fmax(a.y(), fmax(b.y(), c.y())), fmax(a.z(), fmax(b.z(), c.z())));
+
+        tris[i] = i;
+        boxes[i] = aabb(lo, hi);
+        centroids[i] = (a + b + c) / 3;
+    }
+
+    mesh_bvh_part part;
+    if (count > 0)
+    {
+        part.nodes.reserve(2 * (count / 4 + 1));
+        part.packets.reserve(count / 4 + 1);
+        build_node(part, tris, boxes, centroids, 0, count, threads - 1);
+    }
+    nodes = std::move(part.nodes);
+    packets = std::move(part.packets);
+}
+
+void triangle_mesh::fill_packet(triangle_packet &pk, const int *tris, int count) const
+{
+    for (int k = 0; k < 4; k++)
+    {
+        int t = k < count ? tris[k] : -1;
+        point3 a, e1, e2;
+
+        if (t >= 0)
+        {
+            a = vertices[indices[3 * t]];
+            e1 = vertices[indices[3 * t + 1]] - a;
+            e2 = vertices[indices[3 * t + 2]] - a;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            pk.v0[c][k] = a[c];
+            pk.e1[c][k] = e1[c];
+            pk.e2[c][k] = e2[c];
+        }
+        pk.id[k] = t;
+    }
+}
+
+/// append a subtree to part, with the same binned SAH and thread budget as the scene bvh
+void triangle_mesh::build_node(mesh_bvh_part &part, std::vector<int> &tris, const std::vector<aabb> &boxes, const std::vector<point3> &centroids, int start, int end, int spare_threads) const
+{
+    const int parallel_threshold = 4096;
+
+    int index = (int)part.nodes.size();
+    part.nodes.push_back(mesh_node());
+
+    aabb box = boxes[tris[start]];
+    for (int i = start; i < end; i++)
+    {
+        box = surrounding_box(box, boxes[tris[i]]);
+    }
+    part.nodes[index].box = box;
+
+    if (end - start <= 4)
+    {
+        triangle_packet pk;
+        fill_packet(pk, &tris[start], end - start);
+
+        part.nodes[index].next = (int)part.packets.size();
+        part.nodes[index].count = end - start;
+        part.packets.push_back(pk);
+        return;
+    }
+
+    int mid = (int)sah_split(
+        tris, start, end,
+        [&boxes](int t) -> const aabb &
+        { return boxes[t]; },
+        [&centroids](int t) -> const point3 &
+        { return centroids[t]; });
+    part.nodes[index].count = 0;
+
+    if (spare_threads > 0 && end - start > parallel_threshold)
+    {
+        /// the halves touch disjoint ranges of tris, so they are built side by side and spliced in
+        int left_threads = (spare_threads - 1) / 2;
+        int right_threads = spare_threads - 1 - left_threads;
+        mesh_bvh_part left, right;
+
+        std::thread worker([&]()
+                           { build_node(left, tris, boxes, centroids, start, mid, left_threads); });
+        build_node(right, tris, boxes, centroids, mid, end, right_threads);
+        worker.join();
+
+        for (mesh_bvh_part *child : {&left, &right})
+        {
+            int node_offset = (int)part.nodes.size();
+            int packet_offset = (int)part.packets.size();
+            if (child == &right)
+                part.nodes[index].next = node_offset;
+
+            for (mesh_node node : child->nodes)
+            {
+                node.next += node.count > 0 ? packet_offset : node_offset;
+                part.nodes.push_back(node);
+            }
+            part.packets.insert(part.packets.end(), child->packets.begin(), child->packets.end());
+        }
+    }
+    else
+    {
+        build_node(part, tris, boxes, centroids, start, mid, 0);
+        part.nodes[index].next = (int)part.nodes.size();
+        build_node(part, tris, boxes, centroids, mid, end, 0);
+    }
+}
+
+void triangle_mesh::refit()
+{
+    /// children always come after their parent, so a backward sweep sees them first
+    for (int i = (int)nodes.size() - 1; i >= 0; i--)
+    {
+        mesh_node &node = nodes[i];
+
+        if (node.count > 0)
+        {
+            triangle_packet &pk = packets[node.next];
+            fill_packet(pk, pk.id, node.count);
+
+            const point3 &first = vertices[indices[3 * pk.id[0]]];
+            point3 lo = first, hi = first;
+            for (int k = 0; k < node.count; k++)
+            {
+                for (int v = 0; v < 3; v++)
+                {
+                    const point3 &p = vertices[indices[3 * pk.id[k] + v]];
+                    for (int a = 0; a < 3; a++)
+                    {
+                        lo[a] = fmin(lo[a], p[a]);
+                        hi[a] = fmax(hi[a], p[a]);
+                    }
+                }
+            }
+            node.box = aabb(lo, hi);
+        }
+        else
+        {
+            node.box = surrounding_box(nodes[i + 1].box, nodes[node.next].box);
+        }
+    }
+}
+
+bool triangle_mesh::intersect(const ray &r, double t_min, double t_max, hit_record &rec) const
+{
+    if (nodes.empty())
+        return false;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    int hit_id = -1;
+    while (top > 0)
+    {
+        const mesh_node &node = nodes[stack[--top]];
+        if (!node.box.hit(r, t_min, t_max))
+            continue;
+
+        if (node.count > 0)
+        {
+            const triangle_packet &pk = packets[node.next];
+            int lane = intersect_packet(pk, r, t_min, t_max, t_max);
+            if (lane >= 0)
+                hit_id = pk.id[lane];
+        }
+        else
+        {
+            stack[top++] = node.next;
+            stack[top++] = (int)(&node - &nodes[0]) + 1;
+        }
+    }
+
+    if (hit_id < 0)
+        return false;
+
+    rec.t = t_max;
+    rec.object = this;
+    rec.primitive = hit_id;
+
+    return true;
+}
+
+void triangle_mesh::shade(const ray &r, hit_record &rec) const
+{
+    const point3 &a = vertices[indices[3 * rec.primitive]];
+    const point3 &b = vertices[indices[3 * rec.primitive + 1]];
+    const point3 &c = vertices[indices[3 * rec.primitive + 2]];
+
+    rec.p = r.at(rec.t);
+    rec.set_face_normal(r, unit_vector(cross(b - a, c - a)));
+    rec.mat_ptr = mat_ptr.get();
+}
+
+bool triangle_mesh::occluded(const ray &r, double t_min, double t_max) const
+{
+    if (nodes.empty())
+        return false;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    double t_hit;
+    while (top > 0)
+    {
+        const mesh_node &node = nodes[stack[--top]];
+        if (!node.box.hit(r, t_min, t_max))
+            continue;
+
+        if (node.count > 0)
+        {
+            if (intersect_packet(packets[node.next], r, t_min, t_max, t_hit) >= 0)
+                return true;
+        }
+        else
+        {
+            stack[top++] = node.next;
+            stack[top++] = (int)(&node - &nodes[0]) + 1;
+        }
+    }
+
+    return false;
+}
+
+bool triangle_mesh::bounding_box(double time0, double time1, aabb &output_box) const
+{
+    if (nodes.empty())
+        return false;
+
+    output_box = nodes[0].box;
+    return true;
+}
+
+#endif